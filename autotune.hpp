@@ -0,0 +1,208 @@
+// autotune.hpp
+// Startup calibration for both miners. Every self-tested kernel is run at a
+// few thread counts and scheduler batch sizes on this host, and the fastest
+// combination is kept. The result is cached per host (CPU model, microcode,
+// the candidate set) under ~/.cache/cpuminingbtc/tune.json, so calibration
+// runs once per machine type and later starts read the cache. Set
+// MINER_RETUNE=1 to calibrate again, e.g. after a kernel or BIOS change.
+//
+// Workers in the benchmark claim chunks from a NonceScheduler like the real
+// mining threads do, so the batch size is measured with its claim overhead.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "json.hpp"
+#include "nonce_scheduler.hpp"
+#include "cpu_topology.hpp"
+
+// One calibrated configuration; `rate` is hashes/s over all threads
+struct TuneResult {
+    std::string kernel;
+    int threads = 1;
+    uint64_t batch = 0;
+    double rate = 0;
+    bool cached = false;
+};
+
+// ========== Host Identity ==========
+// "model name" (x86) or "CPU part" (arm) and "microcode" from /proc/cpuinfo
+inline std::string cpuIdentity() {
+    std::ifstream f("/proc/cpuinfo");
+    std::string line, model, microcode;
+    while (std::getline(f, line) && (model.empty() || microcode.empty())) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+        std::string value = line.substr(std::min(colon + 2, line.size()));
+        if (model.empty() && (key == "model name" || key == "CPU part")) model = value;
+        if (microcode.empty() && key == "microcode") microcode = value;
+    }
+    return (model.empty() ? "unknown cpu" : model) + " | microcode " + (microcode.empty() ? "?" : microcode);
+}
+
+// Thread counts worth trying with `usable` CPUs: all of them, half, one
+inline std::vector<int> tuneThreadCounts(int usable) {
+    std::vector<int> out = {usable};
+    if (usable / 2 >= 1 && usable / 2 != usable) out.push_back(usable / 2);
+    if (out.back() != 1) out.push_back(1);
+    return out;
+}
+
+// ========== Cache ==========
+inline std::string tuneCachePath() {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    std::string dir;
+    if (xdg && *xdg) dir = xdg;
+    else if (home && *home) dir = std::string(home) + "/.cache";
+    else return ".miner_tune.json";
+    mkdir(dir.c_str(), 0755);
+    dir += "/cpuminingbtc";
+    mkdir(dir.c_str(), 0755);
+    return dir + "/tune.json";
+}
+
+inline nlohmann::json readTuneCache(const std::string& path) {
+    std::ifstream f(path);
+    if (!f) return nlohmann::json::object();
+    try {
+        nlohmann::json j = nlohmann::json::parse(f);
+        if (j.is_object()) return j;
+    } catch (...) {}
+    return nlohmann::json::object();
+}
+
+inline bool loadTune(const std::string& key, TuneResult& out) {
+    nlohmann::json cache = readTuneCache(tuneCachePath());
+    if (!cache.contains(key)) return false;
+    try {
+        const nlohmann::json& e = cache[key];
+        out.kernel = e.at("kernel").get<std::string>();
+        out.threads = e.at("threads").get<int>();
+        out.batch = e.at("batch").get<uint64_t>();
+        out.rate = e.at("rate").get<double>();
+        out.cached = true;
+        return out.threads >= 1 && out.batch > 0;
+    } catch (...) {
+        return false;
+    }
+}
+
+// Merge into the cache file; written to a temp file and renamed so two
+// miners starting together never leave a torn file
+inline void saveTune(const std::string& key, const TuneResult& r) {
+    std::string path = tuneCachePath();
+    nlohmann::json cache = readTuneCache(path);
+    cache[key] = {{"kernel", r.kernel}, {"threads", r.threads}, {"batch", r.batch}, {"rate", r.rate}};
+    std::string tmp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream f(tmp);
+        if (!f) return;
+        f << cache.dump(2) << "\n";
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) remove(tmp.c_str());
+}
+
+// ========== Calibration ==========
+// Hashes/s of `threads` workers pinned in placement order, claiming chunks
+// of `batch` nonces. hashRange(first, last) hashes [first, last).
+template <class HashRange>
+double tuneRate(const std::vector<int>& cpus, int threads, uint64_t batch, HashRange hashRange, int ms) {
+    NonceScheduler scheduler;
+    scheduler.reset(0, 1ULL << 40, threads, 16, batch, batch);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> total{0};
+    std::vector<std::thread> ts;
+    for (int t = 0; t < threads; ++t) {
+        ts.emplace_back([&, t] {
+            if (!cpus.empty()) pinCurrentThread(cpus[t % cpus.size()]);
+            uint64_t n = 0, first, last;
+            while (!stop.load(std::memory_order_relaxed) && scheduler.claim(t, first, last)) {
+                hashRange(first, last);
+                n += last - first;
+            }
+            total += n;
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    stop = true;
+    for (auto& t : ts) t.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return total.load() / seconds;
+}
+
+// Fastest of kernels x threadCounts x batches. hashRange(k, first, last)
+// hashes [first, last) with kernel k. A run only ends between chunks, so
+// the largest batch should take well under `ms` on the slowest kernel.
+template <class HashRange>
+TuneResult calibrate(const std::vector<std::string>& kernels, const std::vector<int>& threadCounts,
+                     const std::vector<uint64_t>& batches, const std::vector<int>& cpus,
+                     HashRange hashRange, int ms = 60) {
+    TuneResult best;
+    for (size_t k = 0; k < kernels.size(); ++k) {
+        auto run = [&](uint64_t first, uint64_t last) { hashRange(k, first, last); };
+        for (int threads : threadCounts) {
+            for (uint64_t batch : batches) {
+                double rate = tuneRate(cpus, threads, batch, run, ms);
+                if (rate > best.rate) {
+                    best.kernel = kernels[k];
+                    best.threads = threads;
+                    best.batch = batch;
+                    best.rate = rate;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// Cache key: binary, host, and everything the candidates were drawn from
+inline std::string tuneKey(const std::string& binary, const std::vector<std::string>& kernels,
+                           const std::vector<int>& threadCounts, const std::vector<uint64_t>& batches) {
+    std::string key = binary + " | " + cpuIdentity() + " | kernels";
+    for (const auto& k : kernels) key += " " + k;
+    key += " | threads";
+    for (int t : threadCounts) key += " " + std::to_string(t);
+    key += " | batches";
+    for (uint64_t b : batches) key += " " + std::to_string(b);
+    return key;
+}
+
+// Cached result for this host, or calibrate now and cache it
+template <class HashRange>
+TuneResult autotune(const std::string& binary, const std::vector<std::string>& kernels,
+                    const std::vector<int>& threadCounts, const std::vector<uint64_t>& batches,
+                    const std::vector<int>& cpus, HashRange hashRange) {
+    std::string key = tuneKey(binary, kernels, threadCounts, batches);
+    const char* retune = getenv("MINER_RETUNE");
+    TuneResult r;
+    if (!(retune && *retune && *retune != '0') && loadTune(key, r) &&
+        std::find(kernels.begin(), kernels.end(), r.kernel) != kernels.end()) {
+        return r;
+    }
+    r = calibrate(kernels, threadCounts, batches, cpus, hashRange);
+    if (r.rate > 0) saveTune(key, r);
+    return r;
+}
+
+inline std::string tuneString(const TuneResult& r) {
+    char buf[160];
+    snprintf(buf, sizeof(buf), "%s x%d threads, batch %llu, %.2f MH/s (%s)", r.kernel.c_str(), r.threads,
+             static_cast<unsigned long long>(r.batch), r.rate / 1e6, r.cached ? "cached" : "calibrated");
+    return buf;
+}
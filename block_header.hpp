@@ -0,0 +1,72 @@
+// block_header.hpp
+// Fixed-size Bitcoin block header and 32-byte hash types for the mining hot
+// path. Headers, digests and per-thread hashing state live on the stack or
+// inside long-lived structs, so hashing never touches the heap.
+
+#pragma once
+
+#include "sha256.hpp"
+
+#include <array>
+
+// Raw SHA-256 / SHA256d output, or a 256-bit target, by value on the stack.
+typedef std::array<uint8_t, 32> Hash256;
+
+inline uint32_t readLE32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline void writeLE32(uint8_t* p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+// ========== Block Header ==========
+// Serialized layout, integers little-endian:
+//   0 version | 4 prev block hash | 36 merkle root | 68 time | 72 bits | 76 nonce
+// Hashes are kept in internal byte order (the reverse of what bitcoind prints).
+// Cache-line aligned so the midstate block (bytes 0..63) is one line.
+struct alignas(64) BlockHeader {
+    static const size_t SIZE = 80;
+    uint8_t bytes[SIZE];
+
+    BlockHeader() { memset(bytes, 0, SIZE); }
+
+    uint32_t version() const { return readLE32(bytes); }
+    const uint8_t* prevHash() const { return bytes + 4; }
+    const uint8_t* merkleRoot() const { return bytes + 36; }
+    uint32_t time() const { return readLE32(bytes + 68); }
+    uint32_t bits() const { return readLE32(bytes + 72); }
+    uint32_t nonce() const { return readLE32(bytes + 76); }
+
+    void setVersion(uint32_t v) { writeLE32(bytes, v); }
+    void setPrevHash(const uint8_t h[32]) { memcpy(bytes + 4, h, 32); }
+    void setMerkleRoot(const uint8_t h[32]) { memcpy(bytes + 36, h, 32); }
+    void setTime(uint32_t t) { writeLE32(bytes + 68, t); }
+    void setBits(uint32_t b) { writeLE32(bytes + 72, b); }
+    void setNonce(uint32_t n) { writeLE32(bytes + 76, n); }
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return SIZE; }
+};
+
+// ========== Per-Thread Hashing State ==========
+// What one mining thread reuses for every batch: its own copy of the job
+// (midstate + precompute) and the buffers a confirmed hit is written to.
+struct HeaderHashState {
+    HeaderJob job;
+    uint32_t words[8];
+    Hash256 hashBE;
+    uint32_t nonce = 0;
+
+    // Full-hash check of a kernel's candidate lanes. On success `nonce` and
+    // `hashBE` (big-endian block hash) describe the hit.
+    bool confirm(uint32_t nonceBase, uint32_t mask) {
+        if (!confirmHeaderHit(job, nonceBase, mask, nonce, words)) return false;
+        headerHashToBE(words, hashBE.data());
+        return true;
+    }
+};
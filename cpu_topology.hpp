@@ -0,0 +1,339 @@
+// cpu_topology.hpp
+// Linux CPU topology and thread placement for the mining threads. The
+// layout comes from /sys/devices/system/cpu (core, package and NUMA node of
+// every online CPU the process may run on). Threads are pinned one per
+// physical core first; SMT siblings are only added when a short benchmark
+// on one core shows that the second hardware thread adds hashrate, which
+// for ALU-bound SHA-256 kernels it often does not.
+//
+// There is no libnuma dependency: memory placement relies on the kernel's
+// first-touch policy, so per-thread job copies made by a pinned thread land
+// on that thread's node.
+//
+// In containers the CPU budget is often smaller than the CPUs we can see:
+// usableCpus() also applies the cgroup (v1 or v2) CFS quota and cpuset, so
+// the miners do not run more threads than the quota pays for and get
+// throttled.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+struct CpuInfo {
+    int cpu = 0;
+    int core = 0;     // physical core, unique across packages
+    int package = 0;
+    int node = 0;
+};
+
+struct CpuTopology {
+    std::vector<CpuInfo> cpus;  // online CPUs in our affinity mask
+    int cores = 0;
+    int nodes = 0;
+    int packages = 0;
+
+    std::string summary() const {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "%d package(s), %d NUMA node(s), %d core(s), %d hardware thread(s)",
+                 packages, nodes, cores, static_cast<int>(cpus.size()));
+        return buf;
+    }
+};
+
+// ========== sysfs Parsing ==========
+inline int readSysInt(const std::string& path, int fallback) {
+    std::ifstream f(path);
+    int v;
+    return (f >> v) ? v : fallback;
+}
+
+// "0-3,8,10-11" -> {0,1,2,3,8,10,11}
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> out;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) comma = list.size();
+        std::string part = list.substr(pos, comma - pos);
+        size_t dash = part.find('-');
+        try {
+            int lo = std::stoi(part.substr(0, dash));
+            int hi = dash == std::string::npos ? lo : std::stoi(part.substr(dash + 1));
+            for (int c = lo; c <= hi; ++c) out.push_back(c);
+        } catch (...) {}
+        pos = comma + 1;
+    }
+    return out;
+}
+
+// NUMA node of a CPU: its sysfs directory holds a `nodeN` link
+inline int cpuNode(int cpu) {
+    std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* d = opendir(dir.c_str());
+    if (!d) return 0;
+    int node = 0;
+    while (dirent* e = readdir(d)) {
+        if (strncmp(e->d_name, "node", 4) == 0 && isdigit(static_cast<unsigned char>(e->d_name[4]))) {
+            node = atoi(e->d_name + 4);
+            break;
+        }
+    }
+    closedir(d);
+    return node;
+}
+
+inline CpuTopology readCpuTopology() {
+    std::vector<int> online;
+    {
+        std::ifstream f("/sys/devices/system/cpu/online");
+        std::string list;
+        if (std::getline(f, list)) online = parseCpuList(list);
+    }
+    if (online.empty()) {
+        for (unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c) online.push_back(c);
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    CpuTopology topo;
+    std::map<std::pair<int, int>, int> coreIds;  // (package, core_id) -> core
+    std::map<int, int> nodeIds, packageIds;
+    for (int cpu : online) {
+        if (haveMask && cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &allowed)) continue;
+        std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        CpuInfo info;
+        info.cpu = cpu;
+        info.package = readSysInt(base + "physical_package_id", 0);
+        int coreId = readSysInt(base + "core_id", cpu);
+        auto key = std::make_pair(info.package, coreId);
+        if (!coreIds.count(key)) coreIds[key] = static_cast<int>(coreIds.size());
+        info.core = coreIds[key];
+        info.node = cpuNode(cpu);
+        nodeIds[info.node] = 1;
+        packageIds[info.package] = 1;
+        topo.cpus.push_back(info);
+    }
+    topo.cores = static_cast<int>(coreIds.size());
+    topo.nodes = static_cast<int>(nodeIds.size());
+    topo.packages = static_cast<int>(packageIds.size());
+    return topo;
+}
+
+// ========== Placement ==========
+// CPUs in the order threads should take them: the first hardware thread of
+// every core, alternating between NUMA nodes, then (with useSmt) the
+// remaining siblings in the same order.
+inline std::vector<int> placementOrder(const CpuTopology& topo, bool useSmt) {
+    std::map<int, std::vector<std::vector<int>>> byNode;  // node -> cores -> cpus
+    std::map<int, std::pair<int, int>> coreSlot;          // core -> (node, index)
+    for (const auto& c : topo.cpus) {
+        auto it = coreSlot.find(c.core);
+        if (it == coreSlot.end()) {
+            auto& cores = byNode[c.node];
+            coreSlot[c.core] = std::make_pair(c.node, static_cast<int>(cores.size()));
+            cores.push_back(std::vector<int>(1, c.cpu));
+        } else {
+            byNode[it->second.first][it->second.second].push_back(c.cpu);
+        }
+    }
+
+    std::vector<int> order;
+    size_t maxSmt = 1;
+    for (const auto& n : byNode) {
+        for (const auto& core : n.second) maxSmt = std::max(maxSmt, core.size());
+    }
+    for (size_t t = 0; t < (useSmt ? maxSmt : 1); ++t) {
+        for (size_t i = 0;; ++i) {
+            bool any = false;
+            for (const auto& n : byNode) {
+                if (i >= n.second.size()) continue;
+                any = true;
+                if (t < n.second[i].size()) order.push_back(n.second[i][t]);
+            }
+            if (!any) break;
+        }
+    }
+    return order;
+}
+
+inline bool pinCurrentThread(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Two hardware threads of one core, or {-1, -1} without SMT
+inline std::pair<int, int> smtPair(const CpuTopology& topo) {
+    for (size_t i = 0; i < topo.cpus.size(); ++i) {
+        for (size_t j = i + 1; j < topo.cpus.size(); ++j) {
+            if (topo.cpus[i].core == topo.cpus[j].core) return std::make_pair(topo.cpus[i].cpu, topo.cpus[j].cpu);
+        }
+    }
+    return std::make_pair(-1, -1);
+}
+
+// ========== SMT Benchmark ==========
+// Hashrate of `hashBatch` (returns hashes done per call) on one hardware
+// thread versus both threads of the same core, run for `ms` each. Returns
+// the two-thread / one-thread ratio, or 0 when there is no SMT to test.
+template <class HashBatch>
+double smtSpeedup(const CpuTopology& topo, HashBatch hashBatch, int ms = 200) {
+    std::pair<int, int> pair = smtPair(topo);
+    if (pair.first < 0) return 0.0;
+
+    auto run = [&](int threads) {
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> total{0};
+        std::vector<std::thread> ts;
+        for (int t = 0; t < threads; ++t) {
+            ts.emplace_back([&, t] {
+                pinCurrentThread(t == 0 ? pair.first : pair.second);
+                uint64_t n = 0;
+                while (!stop.load(std::memory_order_relaxed)) n += hashBatch();
+                total += n;
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        stop = true;
+        for (auto& t : ts) t.join();
+        return static_cast<double>(total.load());
+    };
+    double one = run(1);
+    double two = run(2);
+    return one > 0 ? two / one : 0.0;
+}
+
+// Use SMT siblings only for a clear gain: 10% over one thread per core
+const double SMT_MIN_SPEEDUP = 1.10;
+
+// ========== Container Limits ==========
+struct CgroupCpuLimit {
+    double quota = 0;  // CPUs' worth of CFS quota; 0 = unlimited
+    int cpuset = 0;    // CPUs in the cgroup cpuset; 0 = unknown
+};
+
+inline std::string readSysLine(const std::string& path) {
+    std::ifstream f(path);
+    std::string line;
+    std::getline(f, line);
+    return line;
+}
+
+inline bool dirExists(const std::string& path) {
+    DIR* d = opendir(path.c_str());
+    if (d) closedir(d);
+    return d != nullptr;
+}
+
+// Our cgroup directory under `mount`. Without a cgroup namespace the path
+// from /proc/self/cgroup may not exist inside the container's mount, in
+// which case the mount root is the container's own cgroup.
+inline std::string cgroupDir(const std::string& mount, const std::string& path) {
+    std::string dir = mount + (path == "/" ? "" : path);
+    return dirExists(dir) ? dir : mount;
+}
+
+// Smallest quota on the way from `dir` up to `mount`: a parent's limit
+// binds the children too.
+template <class ReadQuota>
+double minQuotaUpTo(std::string dir, const std::string& mount, ReadQuota readQuota) {
+    double best = 0;
+    while (true) {
+        double q = readQuota(dir);
+        if (q > 0 && (best == 0 || q < best)) best = q;
+        if (dir.size() <= mount.size()) break;
+        dir = dir.substr(0, dir.rfind('/'));
+    }
+    return best;
+}
+
+inline CgroupCpuLimit readCgroupCpuLimit() {
+    CgroupCpuLimit limit;
+    std::ifstream f("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(f, line)) {
+        // hierarchy-id:controllers:path
+        size_t a = line.find(':'), b = line.find(':', a + 1);
+        if (a == std::string::npos || b == std::string::npos) continue;
+        std::string id = line.substr(0, a);
+        std::string controllers = "," + line.substr(a + 1, b - a - 1) + ",";
+        std::string path = line.substr(b + 1);
+
+        if (id == "0" && dirExists("/sys/fs/cgroup") && !readSysLine("/sys/fs/cgroup/cgroup.controllers").empty()) {
+            // v2: cpu.max is "max 100000" or "<quota> <period>"
+            const std::string mount = "/sys/fs/cgroup";
+            std::string dir = cgroupDir(mount, path);
+            double q = minQuotaUpTo(dir, mount, [](const std::string& d) {
+                std::istringstream in(readSysLine(d + "/cpu.max"));
+                std::string quota;
+                double period = 0;
+                if (!(in >> quota >> period) || quota == "max" || period <= 0) return 0.0;
+                return atof(quota.c_str()) / period;
+            });
+            if (q > 0) limit.quota = q;
+            std::string cpus = readSysLine(dir + "/cpuset.cpus.effective");
+            if (!cpus.empty()) limit.cpuset = static_cast<int>(parseCpuList(cpus).size());
+        } else if (controllers.find(",cpu,") != std::string::npos) {
+            // v1: cpu.cfs_quota_us is -1 when unlimited
+            for (const char* m : {"/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu"}) {
+                if (!dirExists(m)) continue;
+                std::string mount = m;
+                double q = minQuotaUpTo(cgroupDir(mount, path), mount, [](const std::string& d) {
+                    double quota = atof(readSysLine(d + "/cpu.cfs_quota_us").c_str());
+                    double period = atof(readSysLine(d + "/cpu.cfs_period_us").c_str());
+                    return quota > 0 && period > 0 ? quota / period : 0.0;
+                });
+                if (q > 0 && (limit.quota == 0 || q < limit.quota)) limit.quota = q;
+                break;
+            }
+        } else if (controllers.find(",cpuset,") != std::string::npos) {
+            std::string dir = cgroupDir("/sys/fs/cgroup/cpuset", path);
+            std::string cpus = readSysLine(dir + "/cpuset.effective_cpus");
+            if (cpus.empty()) cpus = readSysLine(dir + "/cpuset.cpus");
+            if (!cpus.empty()) limit.cpuset = static_cast<int>(parseCpuList(cpus).size());
+        }
+    }
+    return limit;
+}
+
+// Threads worth running: placement CPUs (already within sched_getaffinity),
+// capped by the cpuset and by the quota rounded down (a partial CPU of
+// quota is not worth a thread that then spends its time throttled).
+inline int usableCpus(size_t placementCpus, const CgroupCpuLimit& limit) {
+    int n = static_cast<int>(placementCpus);
+    if (limit.cpuset > 0 && limit.cpuset < n) n = limit.cpuset;
+    if (limit.quota > 0 && std::floor(limit.quota) < n) n = static_cast<int>(std::floor(limit.quota));
+    return n < 1 ? 1 : n;
+}
+
+inline std::string cgroupLimitString(const CgroupCpuLimit& limit) {
+    char buf[96];
+    if (limit.quota > 0) {
+        snprintf(buf, sizeof(buf), "quota %.2f CPUs", limit.quota);
+    } else {
+        snprintf(buf, sizeof(buf), "no quota");
+    }
+    std::string out = buf;
+    if (limit.cpuset > 0) out += ", cpuset " + std::to_string(limit.cpuset) + " CPUs";
+    return out;
+}
@@ -0,0 +1,168 @@
+// merkle.hpp
+// Merkle levels over contiguous arrays of 32-byte hashes (internal byte
+// order, as stored in blocks). Sibling pairs are adjacent in the array, so
+// pair i is simply the 64 bytes at 64 * i and a level is reduced `lanes`
+// pairs per call of a multi-lane SHA256d kernel (PairHasher). When a tree is
+// built from scratch, levels with enough pairs are also split across
+// threads: that runs right after a new tip, when the hashing threads have
+// nothing valid to work on anyway.
+//
+// A template refresh on the same tip mostly keeps its transactions, so a
+// tree can also be updated from the previous one: only nodes with a changed
+// child are hashed again. A replaced transaction costs log2(n) nodes and
+// appended ones only their own subtrees; an insertion shifts (and rehashes)
+// everything after it. Updates stay on the calling thread, since the
+// hashing threads are still busy with the previous template.
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "block_header.hpp"
+#include "sha256_dispatch.hpp"
+
+// Pairs per thread below which a level is hashed on the calling thread only
+const size_t MERKLE_PAIRS_PER_THREAD = 1 << 11;
+
+// Every level of a tree, leaves first and the root last
+struct MerkleTree {
+    std::vector<std::vector<Hash256>> levels;
+
+    // Sibling hash at every level on the path from leaf 0 (the coinbase) to
+    // the root
+    std::vector<Hash256> coinbaseBranch() const {
+        std::vector<Hash256> branch;
+        for (const auto& level : levels) {
+            if (level.size() > 1) branch.push_back(level[1]);
+        }
+        return branch;
+    }
+
+    // Hashed nodes (everything above the leaves)
+    size_t innerNodes() const {
+        size_t n = 0;
+        for (size_t k = 1; k < levels.size(); ++k) n += levels[k].size();
+        return n;
+    }
+};
+
+struct MerkleEngine {
+    PairHasher hasher = {"scalar", 1, hashPairsScalar};
+    int threads = 1;
+
+    // out[i] = SHA256d(level[2i] || level[2i+1]); an odd last hash is paired
+    // with itself. `out` must be another vector than `level`. Uses up to
+    // `workers` threads.
+    void levelUp(const std::vector<Hash256>& level, std::vector<Hash256>& out, int workers) const {
+        size_t full = level.size() / 2;
+        out.resize((level.size() + 1) / 2);
+        hashPairs(level.data()->data(), full, out.data()->data(), workers);
+        if (level.size() % 2 == 1) {
+            uint8_t pair[64];
+            memcpy(pair, level.back().data(), 32);
+            memcpy(pair + 32, level.back().data(), 32);
+            hashPairs(pair, 1, out.back().data(), 1);
+        }
+    }
+
+    MerkleTree build(std::vector<Hash256> leaves) const {
+        return update(MerkleTree(), std::move(leaves));
+    }
+
+    // Tree over `leaves`, reusing every node of `old` whose subtree is
+    // unchanged. `rehashed` (if set) gets the number of nodes hashed. Only a
+    // build (empty `old`) uses more than the calling thread.
+    MerkleTree update(const MerkleTree& old, std::vector<Hash256> leaves, size_t* rehashed = nullptr) const {
+        int workers = old.levels.empty() ? threads : 1;
+        MerkleTree tree;
+        tree.levels.push_back(std::move(leaves));
+        const std::vector<Hash256>* oldLevel = old.levels.empty() ? nullptr : &old.levels[0];
+        // changed[i]: node i of the current level may differ from the old one
+        std::vector<char> changed(tree.levels[0].size());
+        for (size_t i = 0; i < changed.size(); ++i) {
+            changed[i] = !oldLevel || i >= oldLevel->size() || (*oldLevel)[i] != tree.levels[0][i];
+        }
+        std::vector<size_t> todo;
+        std::vector<Hash256> pairs, hashes;
+        if (rehashed) *rehashed = 0;
+
+        for (size_t k = 0; tree.levels[k].size() > 1; ++k) {
+            const std::vector<Hash256>& level = tree.levels[k];
+            size_t n = level.size(), oldN = oldLevel ? oldLevel->size() : 0;
+            const std::vector<Hash256>* oldNext = oldLevel && k + 1 < old.levels.size() ? &old.levels[k + 1] : nullptr;
+            std::vector<Hash256> next((n + 1) / 2);
+            std::vector<char> nextChanged(next.size());
+            todo.clear();
+            for (size_t i = 0; i < next.size(); ++i) {
+                size_t left = 2 * i, right = 2 * i + 1;
+                bool same = false;
+                if (oldNext && i < oldNext->size()) {
+                    if (right < n && right < oldN) same = !changed[left] && !changed[right];
+                    else if (right >= n && right >= oldN) same = !changed[left];  // both self-paired
+                }
+                if (same) next[i] = (*oldNext)[i];
+                else todo.push_back(i);
+                nextChanged[i] = !same;
+            }
+
+            if (todo.size() == next.size()) {
+                levelUp(level, next, workers);
+            } else if (!todo.empty()) {
+                // Changed nodes only: gather their pairs, hash, scatter
+                pairs.resize(2 * todo.size());
+                hashes.resize(todo.size());
+                for (size_t j = 0; j < todo.size(); ++j) {
+                    size_t left = 2 * todo[j];
+                    pairs[2 * j] = level[left];
+                    pairs[2 * j + 1] = left + 1 < n ? level[left + 1] : level[left];
+                }
+                hashPairs(pairs.data()->data(), todo.size(), hashes.data()->data(), workers);
+                for (size_t j = 0; j < todo.size(); ++j) next[todo[j]] = hashes[j];
+            }
+            if (rehashed) *rehashed += todo.size();
+
+            oldLevel = oldNext;
+            changed.swap(nextChanged);
+            tree.levels.push_back(std::move(next));
+        }
+        return tree;
+    }
+
+private:
+    // `pairs` 64-byte messages at `in` -> 32-byte digests at `out`, on up to
+    // `maxWorkers` threads
+    void hashPairs(const uint8_t* in, size_t pairs, uint8_t* out, int maxWorkers) const {
+        size_t lanes = hasher.lanes;
+        size_t workers = std::min<size_t>(maxWorkers, pairs / MERKLE_PAIRS_PER_THREAD);
+        if (workers > 1) {
+            // Whole batches per worker; the last one also takes the rest
+            size_t share = pairs / workers / lanes * lanes;
+            std::vector<std::thread> ts;
+            for (size_t t = 0; t + 1 < workers; ++t) {
+                ts.emplace_back([=] { hashSerial(in + 64 * share * t, share, out + 32 * share * t); });
+            }
+            size_t done = share * (workers - 1);
+            hashSerial(in + 64 * done, pairs - done, out + 32 * done);
+            for (auto& t : ts) t.join();
+            return;
+        }
+        hashSerial(in, pairs, out);
+    }
+
+    void hashSerial(const uint8_t* in, size_t pairs, uint8_t* out) const {
+        size_t lanes = hasher.lanes;
+        size_t i = 0;
+        for (; i + lanes <= pairs; i += lanes) hasher.hash(in + 64 * i, out + 32 * i);
+        if (i < pairs) {
+            // Partial batch through a scratch buffer, unused lanes zeroed
+            uint8_t pairBuf[64 * 16] = {0}, hashBuf[32 * 16];
+            memcpy(pairBuf, in + 64 * i, 64 * (pairs - i));
+            hasher.hash(pairBuf, hashBuf);
+            memcpy(out + 32 * i, hashBuf, 32 * (pairs - i));
+        }
+    }
+};
@@ -0,0 +1,136 @@
+// nonce_scheduler.hpp
+// Dynamic nonce scheduling for the mining threads of both binaries. The
+// range is cut into one home slice per thread; a thread claims contiguous
+// chunks from its own slice and, once that is empty, from whichever slice
+// has the most left. Chunks shrink as a slice drains (guided scheduling),
+// so fast threads on hybrid or shared hosts pick up the tail of slow ones
+// instead of idling at the end of a range.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// One home slice. The cursor is claimed with CAS by its owner and by
+// thieves alike; padded so neighbouring slices do not share a cache line.
+struct NonceSlice {
+    std::atomic<uint64_t> next{0};
+    uint64_t end = 0;
+    std::atomic<uint64_t> claimed{0};  // nonces claimed by this slot's thread
+    std::atomic<uint64_t> stolen{0};   // ... of which from other slices
+    char pad[32];
+};
+
+struct NonceScheduler {
+    std::vector<NonceSlice> slices;
+    uint64_t align = 1;
+    uint64_t minChunk = 1;
+    uint64_t maxChunk = 1;
+
+    // [begin, end) over `threads` slices. Chunk bounds are absolute
+    // multiples of `align`, so lane kernels never get a split batch; only a
+    // chunk starting at an unaligned `begin` or ending at `end` is partial.
+    void reset(uint64_t begin, uint64_t end, int threads, uint64_t alignTo,
+               uint64_t minSize, uint64_t maxSize) {
+        if (end < begin) end = begin;
+        slices = std::vector<NonceSlice>(threads);
+        align = alignTo;
+        minChunk = roundUp(minSize);
+        maxChunk = roundUp(maxSize);
+        uint64_t slice = (end - begin) / threads / align * align;
+        for (int i = 0; i < threads; ++i) {
+            slices[i].next = i == 0 ? begin : alignUp(begin + slice * i, end);
+            slices[i].end = i == threads - 1 ? end : alignUp(begin + slice * (i + 1), end);
+        }
+    }
+
+    // Next chunk [first, last) for `thread`; false once the range is done.
+    // Threads beyond the slice count (added after reset) only steal.
+    bool claim(int thread, uint64_t& first, uint64_t& last) {
+        if (static_cast<size_t>(thread) >= slices.size()) return steal(first, last, nullptr);
+        NonceSlice& own = slices[thread];
+        if (claimFrom(own, first, last)) {
+            own.claimed += last - first;
+            return true;
+        }
+        return steal(first, last, &own);
+    }
+
+    // Per-thread share of the claimed nonces and the max/mean imbalance
+    std::string balanceReport() const {
+        uint64_t total = 0, most = 0, stolen = 0;
+        for (const auto& s : slices) {
+            total += s.claimed;
+            stolen += s.stolen;
+            if (s.claimed > most) most = s.claimed;
+        }
+        std::string out = "work split:";
+        char buf[64];
+        for (const auto& s : slices) {
+            snprintf(buf, sizeof(buf), " %.1f%%", total ? 100.0 * s.claimed / total : 0.0);
+            out += buf;
+        }
+        double mean = slices.empty() ? 0.0 : static_cast<double>(total) / slices.size();
+        snprintf(buf, sizeof(buf), " | max/mean %.2f | stolen %.1f%%",
+                 mean > 0 ? most / mean : 0.0, total ? 100.0 * stolen / total : 0.0);
+        return out + buf;
+    }
+
+private:
+    // Claim from whichever slice has the most left, crediting `own` if set
+    bool steal(uint64_t& first, uint64_t& last, NonceSlice* own) {
+        while (true) {
+            NonceSlice* victim = nullptr;
+            uint64_t most = 0;
+            for (auto& s : slices) {
+                uint64_t next = s.next.load(std::memory_order_relaxed);
+                if (next < s.end && s.end - next > most) {
+                    most = s.end - next;
+                    victim = &s;
+                }
+            }
+            if (!victim) return false;
+            if (claimFrom(*victim, first, last)) {
+                if (own) {
+                    own->claimed += last - first;
+                    own->stolen += last - first;
+                }
+                return true;
+            }
+        }
+    }
+
+    uint64_t roundUp(uint64_t n) const {
+        return n < align ? align : (n + align - 1) / align * align;
+    }
+
+    // `n` rounded up to a multiple of `align`, or `limit` if that is closer
+    uint64_t alignUp(uint64_t n, uint64_t limit) const {
+        if (n >= limit) return limit;
+        uint64_t down = n - n % align;
+        if (down == n) return n;
+        return limit - down <= align ? limit : down + align;
+    }
+
+    bool claimFrom(NonceSlice& s, uint64_t& first, uint64_t& last) {
+        uint64_t next = s.next.load(std::memory_order_relaxed);
+        while (next < s.end) {
+            // Guided: a fraction of what is left, within [minChunk, maxChunk]
+            uint64_t left = s.end - next;
+            uint64_t size = roundUp(left / (2 * slices.size()));
+            if (size < minChunk) size = minChunk;
+            if (size > maxChunk) size = maxChunk;
+            if (size > left) size = left;
+            uint64_t stop = alignUp(next + size, s.end);
+            if (s.next.compare_exchange_weak(next, stop, std::memory_order_relaxed)) {
+                first = next;
+                last = stop;
+                return true;
+            }
+        }
+        return false;
+    }
+};
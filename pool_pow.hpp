@@ -0,0 +1,359 @@
+// pool_pow.hpp
+// Pool proof of work: SHA-256 of the job data followed by the nonce in ASCII
+// decimal. The message length, the padding position and the length word only
+// change when the nonce gains a digit, so a nonce range is swept in runs of
+// equal digit count, each by a kernel instantiated for that digit count.
+// Whole data blocks in front of the nonce are compressed once per job (the
+// midstate); per run the tail blocks are laid out with their padding and
+// length once, and per nonce only the digits are rewritten.
+//
+// The lane kernels (pool_lanes.inc) hash 4/8/16 consecutive nonces at once.
+// They need contiguous ranges (step 1); the scalar sweep also serves
+// strided ranges and the few nonces the lanes cannot take.
+
+#pragma once
+
+#include "sha256.hpp"
+#include "sha256_dispatch.hpp"
+
+#include <string>
+#include <vector>
+
+// ========== Job ==========
+// Everything about `data + decimal(nonce)` that stays fixed while the nonce
+// sweeps. `target` is the pool's hex target as a 256-bit big-endian number.
+struct DecimalJob {
+    uint32_t midstate[8];  // state after data's whole 64-byte blocks
+    uint8_t head[64];      // data bytes after those blocks
+    size_t headLen;
+    uint64_t dataLen;
+    uint8_t target[32];
+};
+
+inline DecimalJob prepareDecimalJob(Sha256TransformFn transform, const std::string& data,
+                                    const uint8_t target[32]) {
+    DecimalJob job;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+    size_t full = data.size() / 64;
+    memcpy(job.midstate, SHA256_IV, sizeof(job.midstate));
+    if (full) transform(job.midstate, p, full);
+    job.headLen = data.size() - full * 64;
+    memcpy(job.head, p + full * 64, job.headLen);
+    job.dataLen = data.size();
+    memcpy(job.target, target, 32);
+    return job;
+}
+
+// ========== Decimal Digits ==========
+inline int decimalDigits(uint64_t v) {
+    int n = 1;
+    while (v >= 10) {
+        v /= 10;
+        ++n;
+    }
+    return n;
+}
+
+// Smallest value with more than `digits` digits (0 once past uint64_t).
+inline uint64_t decimalRunEnd(int digits) {
+    uint64_t end = 1;
+    for (int i = 0; i < digits; ++i) {
+        if (end > UINT64_MAX / 10) return 0;
+        end *= 10;
+    }
+    return end;
+}
+
+template <int Digits>
+inline void writeDecimalFixed(uint8_t* p, uint64_t v) {
+#pragma GCC unroll 20
+    for (int i = Digits - 1; i >= 0; --i) {
+        p[i] = '0' + v % 10;
+        v /= 10;
+    }
+}
+
+// Add `step` in place; the caller guarantees the sum keeps Digits digits.
+template <int Digits>
+inline void addDecimalFixed(uint8_t* p, uint64_t step) {
+    uint64_t carry = step;
+    for (int i = Digits - 1; i >= 0 && carry; --i) {
+        uint64_t v = (p[i] - '0') + carry;
+        p[i] = '0' + v % 10;
+        carry = v / 10;
+    }
+}
+
+// ========== Fixed-Length Kernel ==========
+// Hashes `count` nonces first, first + step, ... (all with Digits digits).
+// Returns true with `nonce` and the big-endian digest in `hash` on the first
+// digest below the target.
+template <int Digits>
+bool sweepDecimalRun(const DecimalJob& job, Sha256TransformFn transform, uint64_t first,
+                     uint64_t count, uint64_t step, uint64_t& nonce, uint8_t hash[32]) {
+    // Tail layout for this length: head, digits, 0x80, zeros, bit length
+    const size_t msgTail = job.headLen + Digits;
+    const size_t blocks = msgTail + 9 <= 64 ? 1 : 2;
+    uint8_t tail[128] = {0};
+    memcpy(tail, job.head, job.headLen);
+    uint8_t* digits = tail + job.headLen;
+    tail[msgTail] = 0x80;
+    uint64_t bits = (job.dataLen + Digits) * 8;
+    for (int i = 0; i < 8; ++i) tail[blocks * 64 - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    writeDecimalFixed<Digits>(digits, first);
+
+    uint32_t state[8];
+    for (uint64_t k = 0; k < count; ++k) {
+        memcpy(state, job.midstate, sizeof(state));
+        transform(state, tail, blocks);
+        for (int i = 0; i < 8; ++i) writeBE32(hash + 4 * i, state[i]);
+        if (memcmp(hash, job.target, 32) < 0) {
+            nonce = first + k * step;
+            return true;
+        }
+        addDecimalFixed<Digits>(digits, step);
+    }
+    return false;
+}
+
+typedef bool (*DecimalRunFn)(const DecimalJob& job, Sha256TransformFn transform, uint64_t first,
+                             uint64_t count, uint64_t step, uint64_t& nonce, uint8_t hash[32]);
+
+inline DecimalRunFn decimalRunKernel(int digits) {
+    static const DecimalRunFn kernels[21] = {
+        nullptr,
+        sweepDecimalRun<1>, sweepDecimalRun<2>, sweepDecimalRun<3>, sweepDecimalRun<4>,
+        sweepDecimalRun<5>, sweepDecimalRun<6>, sweepDecimalRun<7>, sweepDecimalRun<8>,
+        sweepDecimalRun<9>, sweepDecimalRun<10>, sweepDecimalRun<11>, sweepDecimalRun<12>,
+        sweepDecimalRun<13>, sweepDecimalRun<14>, sweepDecimalRun<15>, sweepDecimalRun<16>,
+        sweepDecimalRun<17>, sweepDecimalRun<18>, sweepDecimalRun<19>, sweepDecimalRun<20>
+    };
+    return kernels[digits];
+}
+
+// ========== Range Sweep ==========
+// Nonces first, first + step, ... below `last`, split into equal-digit runs.
+// On a hit `nonce` is the share; on a miss it is the next nonce in the
+// sequence (UINT64_MAX if that is past the end of the nonce space).
+inline bool sweepDecimal(const DecimalJob& job, Sha256TransformFn transform, uint64_t first,
+                         uint64_t last, uint64_t step, uint64_t& nonce, uint8_t hash[32]) {
+    while (first < last) {
+        int digits = decimalDigits(first);
+        uint64_t runEnd = decimalRunEnd(digits);
+        if (runEnd == 0 || runEnd > last) runEnd = last;
+        uint64_t count = (runEnd - first + step - 1) / step;
+        if (decimalRunKernel(digits)(job, transform, first, count, step, nonce, hash)) return true;
+        if (count > (UINT64_MAX - first) / step) {
+            nonce = UINT64_MAX;
+            return false;
+        }
+        first += count * step;
+    }
+    nonce = first;
+    return false;
+}
+
+// ========== Lane Job ==========
+// One 10^4-aligned block of nonces: all digits but the last four are fixed.
+// `w` is the first block holding those four digits (and the one after it,
+// if any) with the four digit bytes zeroed.
+struct DecimalLanesJob {
+    uint32_t init[8];   // state before that block
+    uint32_t pre[8];    // init after rounds [0, from)
+    uint32_t w[32];
+    int from;           // first round whose word holds a varying digit
+    int blocks;         // blocks left to compress from `init`: 1 or 2
+    int at, shift;      // low digits as a BE word: w[at] |= d >> shift, w[at + 1] |= d << (32 - shift)
+    uint32_t target0;   // top target word
+};
+
+// lo (0..9999) as four digit values, one per byte, most significant first
+inline uint32_t decimalDigitBytes(uint32_t lo) {
+    return (lo / 1000 << 24) | (lo / 100 % 10 << 16) | (lo / 10 % 10 << 8) | lo % 10;
+}
+
+// Lane job for nonces hi * 10^4 .. hi * 10^4 + 9999, all `digits` long
+inline DecimalLanesJob prepareDecimalLanes(const DecimalJob& job, Sha256TransformFn transform,
+                                           int digits, uint64_t hi) {
+    uint8_t tail[128] = {0};
+    memcpy(tail, job.head, job.headLen);
+    uint8_t* p = tail + job.headLen;
+    for (int i = digits - 5; i >= 0; --i) {
+        p[i] = '0' + hi % 10;
+        hi /= 10;
+    }
+    size_t msgTail = job.headLen + digits;
+    size_t blocks = msgTail + 9 <= 64 ? 1 : 2;
+    tail[msgTail] = 0x80;
+    uint64_t bits = (job.dataLen + digits) * 8;
+    for (int i = 0; i < 8; ++i) tail[blocks * 64 - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+
+    DecimalLanesJob j;
+    size_t lowAt = msgTail - 4;
+    size_t skip = lowAt >= 64 ? 1 : 0;  // a first tail block without varying digits
+    memcpy(j.init, job.midstate, sizeof(j.init));
+    if (skip) transform(j.init, tail, 1);
+    j.blocks = static_cast<int>(blocks - skip);
+    for (int i = 0; i < 16 * j.blocks; ++i) j.w[i] = readBE32(tail + 64 * skip + 4 * i);
+    j.at = static_cast<int>((lowAt - 64 * skip) / 4);
+    j.shift = static_cast<int>(lowAt % 4) * 8;
+    j.from = j.at;
+    memcpy(j.pre, j.init, sizeof(j.pre));
+    for (int i = 0; i < j.from; ++i) sha256Round(j.pre, i, j.w[i]);
+    j.target0 = readBE32(job.target);
+    return j;
+}
+
+typedef uint32_t (*DecimalScanFn)(const DecimalLanesJob& j, uint32_t lo, uint32_t batches,
+                                  uint32_t& index);
+
+struct DecimalScanner {
+    const char* name;
+    int lanes;
+    DecimalScanFn scan;
+};
+
+#ifdef SHA256_HAVE_X86
+
+namespace sha256_sse41 {
+#define SHA256_LANE_TARGET SHA256_TARGET_SSE41
+#include "pool_lanes.inc"
+#undef SHA256_LANE_TARGET
+} // namespace sha256_sse41
+
+namespace sha256_avx2 {
+#define SHA256_LANE_TARGET SHA256_TARGET_AVX2
+#include "pool_lanes.inc"
+#undef SHA256_LANE_TARGET
+} // namespace sha256_avx2
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+namespace sha256_avx512 {
+#define SHA256_LANE_TARGET SHA256_TARGET_AVX512
+#include "pool_lanes.inc"
+#undef SHA256_LANE_TARGET
+} // namespace sha256_avx512
+#pragma GCC diagnostic pop
+
+inline uint32_t scanDecimalSse41(const DecimalLanesJob& j, uint32_t lo, uint32_t batches, uint32_t& index) {
+    return sha256_sse41::ScanDecimal(j, lo, batches, index);
+}
+
+inline uint32_t scanDecimalAvx2(const DecimalLanesJob& j, uint32_t lo, uint32_t batches, uint32_t& index) {
+    return sha256_avx2::ScanDecimal(j, lo, batches, index);
+}
+
+inline uint32_t scanDecimalAvx512(const DecimalLanesJob& j, uint32_t lo, uint32_t batches, uint32_t& index) {
+    return sha256_avx512::ScanDecimal(j, lo, batches, index);
+}
+
+#endif // SHA256_HAVE_X86
+
+// ========== Contiguous Sweep ==========
+// Nonces first .. last - 1 through the lane kernel; the nonces below 1000,
+// ahead of lane alignment and at the end of the range go through the scalar
+// sweep. Candidate lanes are confirmed with the full digest, so the result
+// matches sweepDecimal(..., step = 1, ...).
+inline bool sweepDecimalLanes(const DecimalJob& job, Sha256TransformFn transform,
+                              const DecimalScanner& scanner, uint64_t first, uint64_t last,
+                              uint64_t& nonce, uint8_t hash[32]) {
+    const uint64_t lanes = scanner.lanes;
+    while (first < last) {
+        if (first < 1000 || first % lanes || last - first < lanes || first > UINT64_MAX - 20000) {
+            uint64_t stop = first < 1000 ? 1000 : (first / lanes + 1) * lanes;
+            if (stop > last || stop < first) stop = last;
+            if (sweepDecimal(job, transform, first, stop, 1, nonce, hash)) return true;
+            first = stop;
+            continue;
+        }
+
+        uint64_t end = (first / 10000 + 1) * 10000;
+        if (end > last) end = last;
+        uint32_t batches = static_cast<uint32_t>((end - first) / lanes);
+        DecimalLanesJob lj = prepareDecimalLanes(job, transform, decimalDigits(first), first / 10000);
+        while (batches) {
+            uint32_t index;
+            uint32_t mask = scanner.scan(lj, first % 10000, batches, index);
+            if (!mask) {
+                first += batches * lanes;
+                break;
+            }
+            uint64_t base = first + index * lanes;
+            while (mask) {
+                uint64_t n = base + __builtin_ctz(mask);
+                mask &= mask - 1;
+                if (sweepDecimal(job, transform, n, n + 1, 1, nonce, hash)) return true;
+            }
+            first = base + lanes;
+            batches -= index + 1;
+        }
+    }
+    nonce = last;
+    return false;
+}
+
+// ========== Self-Test and Selection ==========
+// Every candidate mask must match what OpenSSL's digests say, across data
+// lengths that put the low digits in either tail block or across a word.
+inline bool selfTestDecimalScanner(const DecimalScanner& s) {
+    std::mt19937 rng(0xdec1);
+    for (size_t len = 0; len < 140; len += 1 + rng() % 5) {
+        std::string data(len, 'x');
+        for (auto& c : data) c = "0123456789abcdef"[rng() % 16];
+        uint64_t hi = 1 + rng() % 100000;
+        uint32_t lo = (rng() % (10000 / s.lanes - 4)) * s.lanes;
+        uint64_t first = hi * 10000 + lo;
+        int digits = decimalDigits(first);
+
+        // Top digest words of 4 batches; the target is one lane's own word
+        std::vector<uint32_t> top(4 * s.lanes);
+        for (size_t i = 0; i < top.size(); ++i) {
+            std::string msg = data + std::to_string(first + i);
+            uint8_t h[32];
+            SHA256(reinterpret_cast<const uint8_t*>(msg.data()), msg.size(), h);
+            top[i] = readBE32(h);
+        }
+        uint8_t target[32];
+        memset(target, 0xff, sizeof(target));
+        writeBE32(target, top[rng() % top.size()]);
+
+        DecimalJob job = prepareDecimalJob(sha256Transform, data, target);
+        DecimalLanesJob lj = prepareDecimalLanes(job, sha256Transform, digits, hi);
+        uint32_t wantIndex = 4, wantMask = 0;
+        for (uint32_t b = 0; b < 4 && !wantMask; ++b) {
+            for (int lane = 0; lane < s.lanes; ++lane) {
+                if (top[b * s.lanes + lane] <= lj.target0) wantMask |= 1u << lane;
+            }
+            wantIndex = b;
+        }
+        if (!wantMask) wantIndex = 4;
+        uint32_t index;
+        uint32_t mask = s.scan(lj, lo, 4, index);
+        if (mask != wantMask || index != wantIndex) return false;
+    }
+    return true;
+}
+
+// Best-first. An empty result means no lane kernel: sweep with the scalar
+// path on the selected single-message transform.
+inline std::vector<DecimalScanner> decimalScannerCandidates(const CpuFeatures& f) {
+    std::vector<DecimalScanner> out;
+#ifdef SHA256_HAVE_X86
+    if (f.avx512f) out.push_back(DecimalScanner{"avx512f", 16, scanDecimalAvx512});
+    if (f.avx2) out.push_back(DecimalScanner{"avx2", 8, scanDecimalAvx2});
+    if (f.sse41) out.push_back(DecimalScanner{"sse4.1", 4, scanDecimalSse41});
+#endif
+    return out;
+}
+
+// Every lane kernel that passes its self-test, best-first
+inline std::vector<DecimalScanner> passingDecimalScanners() {
+    std::vector<DecimalScanner> out;
+    for (const auto& s : decimalScannerCandidates(detectCpuFeatures())) {
+        if (selfTestDecimalScanner(s)) out.push_back(s);
+        else std::cerr << "Decimal lane kernel " << s.name << " failed self-test, skipping\n";
+    }
+    return out;
+}
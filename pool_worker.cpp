@@ -1,13 +1,13 @@
 // pool_worker.cpp
 #include <iostream>
 #include <string>
-#include <sstream>
 #include <thread>
 #include <vector>
 #include <mutex>
 #include <atomic>
+#include <memory>
+#include <condition_variable>
 #include <chrono>
-#include <iomanip>
 #include <openssl/sha.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -16,6 +16,11 @@
 #include <cstring>
 #include <climits>
 #include "json.hpp"
+#include "sha256_dispatch.hpp"
+#include "pool_pow.hpp"
+#include "nonce_scheduler.hpp"
+#include "cpu_topology.hpp"
+#include "autotune.hpp"
 
 using json = nlohmann::json;
 using namespace std;
@@ -23,24 +28,129 @@ using namespace std;
 mutex cout_mutex;
 mutex send_mutex;
 
-// SHA256
-string sha256(const string &str) {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256((unsigned char*)str.c_str(), str.size(), hash);
-    stringstream ss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << hex << setw(2) << setfill('0') << (int)hash[i];
+// SHA256 (kernel picked at startup by selectSha256Kernel)
+Sha256Kernel sha256_kernel = {"portable", sha256OpenSSL, sha256Transform};
+// Multi-lane PoW kernel (picked by autotune); scan is null when there is none
+DecimalScanner decimal_scanner = {"none", 1, nullptr};
+// Workers with thread_id >= active_threads stay parked (cgroup CPU quota)
+atomic<int> active_threads{1};
+const int QUOTA_POLL_SECONDS = 5;
+
+string to_hex(const uint8_t* bytes, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    string out(len * 2, '0');
+    for (size_t i = 0; i < len; i++) {
+        out[2 * i] = digits[bytes[i] >> 4];
+        out[2 * i + 1] = digits[bytes[i] & 0xf];
     }
-    return ss.str();
+    return out;
 }
 
-// Mining function
-void mine_job(string data, string target, int thread_id, int sock, atomic<bool>& job_done,
-              uint64_t start_nonce, uint64_t step, uint64_t nonce_end) {
+// The pool compares hex strings (`hash < target`). For a lowercase hex target
+// that is the same as comparing 32 raw bytes once the target is padded with
+// '0' to 64 digits, so it is decoded to binary once per job.
+bool decode_target(const string& target, uint8_t out[32]) {
+    if (target.size() > 64) return false;
+    string padded = target + string(64 - target.size(), '0');
+    for (int i = 0; i < 32; i++) {
+        int v = 0;
+        for (int k = 0; k < 2; k++) {
+            char c = padded[2 * i + k];
+            if (c >= '0' && c <= '9') v = v * 16 + (c - '0');
+            else if (c >= 'a' && c <= 'f') v = v * 16 + (c - 'a' + 10);
+            else return false;
+        }
+        out[i] = v;
+    }
+    return true;
+}
+
+// Job as received from the pool. `done` is set once a share is found, which
+// ends the job for every worker (one share per job). The job's nonce range
+// lives only in `scheduler`, which workers claim chunks from.
+struct Job {
+    string id;
+    DecimalJob pow;
+    int sock = -1;
+    atomic<bool> done{false};
+    NonceScheduler scheduler;
+};
+
+// Latest job, versioned by an epoch counter. The reader thread publishes and
+// never waits for workers; workers compare `epoch` between kernel batches
+// (mine_batch) and drop the job they are on once it moves. A null job means
+// idle (disconnected).
+struct JobSlot {
+    atomic<uint64_t> epoch{0};
+    mutex m;
+    condition_variable cv;
+    shared_ptr<Job> job;
+
+    void publish(shared_ptr<Job> j) {
+        {
+            lock_guard<mutex> lock(m);
+            job = j;
+            epoch++;
+        }
+        cv.notify_all();
+    }
+
+    // Wake parked workers after active_threads changed. The epoch stays, so
+    // chunks already claimed from the scheduler are finished, not dropped.
+    void wake() {
+        {
+            lock_guard<mutex> lock(m);
+        }
+        cv.notify_all();
+    }
+
+    // Block until the epoch moves past `seen` and return that job. With
+    // `resume` (the caller was parked) also return the current job as soon
+    // as `thread_id` is active again.
+    shared_ptr<Job> wait_newer(uint64_t& seen, bool resume, int thread_id) {
+        unique_lock<mutex> lock(m);
+        cv.wait(lock, [&] {
+            return epoch.load() != seen || (resume && thread_id < active_threads.load());
+        });
+        seen = epoch.load();
+        return job;
+    }
+};
+
+// Hashes per kernel call. The epoch and `done` are checked between calls,
+// so this bounds how long a worker keeps hashing a superseded job. Also the
+// smallest scheduler chunk. Set at startup by the auto-tuner from
+// TUNE_BATCHES.
+uint64_t mine_batch = 4096;
+const vector<uint64_t> TUNE_BATCHES = {1024, 4096, 16384};
+const uint64_t PROGRESS_EVERY = 1000000;
+// Largest scheduler chunk (nonces per claim)
+const uint64_t CHUNK_MAX = 1 << 20;
+
+// Mining function: hashes the contiguous range [start_nonce, end_nonce).
+// Returns false once the job is over (share found or superseded).
+// `pow` is the worker's own copy of job.pow.
+bool mine_chunk(Job& job, const DecimalJob& pow, int thread_id, const JobSlot& slot, uint64_t epoch,
+                uint64_t start_nonce, uint64_t end_nonce) {
+    int sock = job.sock;
+    uint8_t hash_bin[32];
     uint64_t nonce = start_nonce;
-    while (!job_done && nonce < nonce_end) {
-        string hash = sha256(data + to_string(nonce));
-        if (hash < target) {
+    while (nonce < end_nonce) {
+        if (job.done || slot.epoch.load(memory_order_relaxed) != epoch) return false;
+
+        // Stop each batch at the next progress mark so it can be reported
+        uint64_t last = end_nonce;
+        if (last - nonce > mine_batch) last = nonce + mine_batch;
+        uint64_t mark = (nonce / PROGRESS_EVERY + 1) * PROGRESS_EVERY;
+        if (mark > nonce && mark < last) last = mark;
+
+        uint64_t next;
+        bool found = decimal_scanner.scan
+            ? sweepDecimalLanes(pow, sha256_kernel.transform, decimal_scanner, nonce, last, next, hash_bin)
+            : sweepDecimal(pow, sha256_kernel.transform, nonce, last, 1, next, hash_bin);
+        if (found) {
+            nonce = next;
+            string hash = to_hex(hash_bin, 32);
             json msg_json = {
                 {"method", "submit"},
                 {"params", {nonce, hash}},
@@ -48,18 +158,20 @@ void mine_job(string data, string target, int thread_id, int sock, atomic<bool>&
             };
             string msg = msg_json.dump() + "\n";
             {
+                // Epoch re-checked under send_mutex: the socket may be closing
                 lock_guard<mutex> lock(send_mutex);
+                if (slot.epoch.load() != epoch) return false;
                 send(sock, msg.c_str(), msg.size(), 0);
             }
 
-            job_done = true;
+            job.done = true;
             lock_guard<mutex> lock(cout_mutex);
             cout << "[Thread " << thread_id << "] Found nonce " << nonce << " hash " << hash << endl;
-            break;
+            return false;
         }
+        nonce = next;
 
-        nonce += step;
-        if (nonce % 1000000 == 0) {
+        if (nonce % PROGRESS_EVERY == 0) {
             json progress_json = {
                 {"method", "progress"},
                 {"params", {nonce, thread_id}}
@@ -67,16 +179,142 @@ void mine_job(string data, string target, int thread_id, int sock, atomic<bool>&
             string progress = progress_json.dump() + "\n";
             {
                 lock_guard<mutex> lock(send_mutex);
+                if (slot.epoch.load() != epoch) return false;
                 send(sock, progress.c_str(), progress.size(), 0);
             }
         }
     }
+    return true;
 }
 
-int main() {
+// Long-lived worker: mines whatever the slot holds, switching on every epoch.
+// Pinned to `cpu` (-1: unpinned); the per-job copy of the PoW state is made
+// on this thread so it sits on the worker's NUMA node.
+void worker_loop(JobSlot& slot, int thread_id, int cpu) {
+    if (cpu >= 0) pinCurrentThread(cpu);
+    uint64_t seen = 0;
+    bool parked = false;
+    while (true) {
+        shared_ptr<Job> job = slot.wait_newer(seen, parked, thread_id);
+        parked = false;
+        if (!job) continue;
+        DecimalJob pow = job->pow;
+        // Own slice first, then help whichever thread is furthest behind.
+        // Parking is only checked between chunks, so a claimed chunk is
+        // always mined to the end; its slice is left to the active threads.
+        uint64_t first, last;
+        while (true) {
+            if (thread_id >= active_threads.load(memory_order_relaxed)) {
+                parked = true;
+                break;
+            }
+            if (!job->scheduler.claim(thread_id, first, last) ||
+                !mine_chunk(*job, pow, thread_id, slot, seen, first, last)) {
+                break;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
     const char* server_ip = "127.0.0.1";
     int port = 3333;
-    int num_threads = 4;
+
+    sha256_kernel = selectSha256Kernel();
+    cout << "CPU features: " << cpuFeatureString(detectCpuFeatures()) << endl;
+    cout << "SHA256 kernel: " << sha256_kernel.name << endl;
+    // Self-tested lane kernels, best-first until the auto-tuner picks one
+    vector<DecimalScanner> scanners = passingDecimalScanners();
+    if (!scanners.empty()) decimal_scanner = scanners.front();
+
+    // Placement: one worker per physical core, SMT siblings only if they pay
+    CpuTopology topo = readCpuTopology();
+    uint8_t bench_target[32] = {0};
+    DecimalJob bench = prepareDecimalJob(sha256_kernel.transform, "0123456789abcdef", bench_target);
+    double smt = smtSpeedup(topo, [&] {
+        uint64_t next;
+        uint8_t hash[32];
+        if (decimal_scanner.scan) {
+            sweepDecimalLanes(bench, sha256_kernel.transform, decimal_scanner, 1000000, 1000000 + mine_batch, next, hash);
+        } else {
+            sweepDecimal(bench, sha256_kernel.transform, 1000000, 1000000 + mine_batch, 1, next, hash);
+        }
+        return mine_batch;
+    });
+    vector<int> cpus = placementOrder(topo, smt >= SMT_MIN_SPEEDUP);
+    cout << "CPU topology: " << topo.summary() << endl;
+    if (smt > 0) {
+        cout << "SMT speedup x" << smt << (smt >= SMT_MIN_SPEEDUP ? ", using siblings" : ", one thread per core") << endl;
+    }
+
+    // Threads: first argument, default one per placement CPU. Without an
+    // argument the active count follows the cgroup CPU quota.
+    bool fixed_threads = argc > 1;
+    int num_threads = fixed_threads ? atoi(argv[1]) : static_cast<int>(cpus.size());
+    if (num_threads < 1) num_threads = 1;
+    CgroupCpuLimit limit = readCgroupCpuLimit();
+    int usable = fixed_threads ? num_threads : usableCpus(cpus.size(), limit);
+    cout << "Container limit: " << cgroupLimitString(limit) << endl;
+
+    // Auto-tune lane kernel (or the scalar sweep), thread count and batch
+    // size on this host; cached per CPU model and microcode
+    vector<string> kernel_names;
+    for (const auto& s : scanners) kernel_names.push_back(s.name);
+    kernel_names.push_back(sha256_kernel.name);
+    TuneResult tune = autotune("pool_worker", kernel_names, fixed_threads ? vector<int>{num_threads} : tuneThreadCounts(usable),
+                               TUNE_BATCHES, cpus,
+                               [&](size_t k, uint64_t first, uint64_t last) {
+        uint64_t next;
+        uint8_t hash[32];
+        if (k < scanners.size()) {
+            sweepDecimalLanes(bench, sha256_kernel.transform, scanners[k], first, last, next, hash);
+        } else {
+            sweepDecimal(bench, sha256_kernel.transform, first, last, 1, next, hash);
+        }
+    });
+    decimal_scanner = DecimalScanner{"none", 1, nullptr};
+    for (const auto& s : scanners) {
+        if (tune.kernel == s.name) decimal_scanner = s;
+    }
+    mine_batch = tune.batch;
+    cout << "Auto-tune: " << tuneString(tune) << endl;
+
+    // Fewer threads than usable only if they measured faster; otherwise the
+    // active count keeps following the quota up to every placement CPU
+    size_t max_threads = tune.threads < usable ? tune.threads : cpus.size();
+    if (fixed_threads) {
+        active_threads = num_threads;
+    } else {
+        num_threads = static_cast<int>(max_threads);
+        active_threads = usableCpus(max_threads, limit);
+    }
+    cout << "Worker threads: " << active_threads << " active of " << num_threads << endl;
+
+    // Worker pool lives for the whole process; the socket loop only publishes jobs
+    JobSlot slot;
+    vector<thread> workers;
+    for (int i = 0; i < num_threads; ++i) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        workers.emplace_back(worker_loop, ref(slot), i, cpu);
+    }
+
+    // Follow quota changes at runtime: park or wake workers in place
+    if (!fixed_threads) {
+        workers.emplace_back([&slot, max_threads] {
+            while (true) {
+                this_thread::sleep_for(chrono::seconds(QUOTA_POLL_SECONDS));
+                CgroupCpuLimit now = readCgroupCpuLimit();
+                int usable = usableCpus(max_threads, now);
+                if (usable == active_threads.load()) continue;
+                {
+                    lock_guard<mutex> lock(cout_mutex);
+                    cout << "Container limit now " << cgroupLimitString(now) << ", " << usable << " active workers" << endl;
+                }
+                active_threads = usable;
+                slot.wake();
+            }
+        });
+    }
 
     while (true) {
         int sock = socket(AF_INET, SOCK_STREAM, 0);
@@ -106,6 +344,7 @@ int main() {
         cout << "Connected to pool server at " << server_ip << ":" << port << endl;
 
         string current_job_id = "";
+        shared_ptr<Job> current;
         string last_data = "";
         string recv_buffer;
         char temp[4096];
@@ -167,28 +406,41 @@ int main() {
                     continue;
                 }
 
+                // A rejected job is not recorded, so a corrected resend with
+                // the same id or data is still taken
+                uint8_t target_bin[32];
+                if (!decode_target(target, target_bin)) {
+                    cerr << "Invalid job target: " << target << "\n";
+                    continue;
+                }
                 current_job_id = incoming_job_id;
                 last_data = data;
 
-                // --- เริ่ม mining ---
-                atomic<bool> job_done(false);
-                vector<thread> threads;
-                for (int i = 0; i < num_threads; ++i) {
-                    uint64_t actual_start = nonce_start + i;
-                    uint64_t step = num_threads;
-                    threads.emplace_back(mine_job, data, target, i, sock, ref(job_done),
-                                         actual_start, step, nonce_end);
-                }
-                for (auto& t : threads) {
-                    if (t.joinable()) t.join();
+                // --- ส่ง job ให้ worker pool (ไม่รอ) ---
+                shared_ptr<Job> next = make_shared<Job>();
+                next->pow = prepareDecimalJob(sha256_kernel.transform, data, target_bin);
+                next->sock = sock;
+                next->id = incoming_job_id;
+                next->scheduler.reset(nonce_start, nonce_end, active_threads, 16, mine_batch, CHUNK_MAX);
+                if (current) {
+                    lock_guard<mutex> lock(cout_mutex);
+                    cout << "[Job " << current->id << "] " << current->scheduler.balanceReport() << endl;
                 }
+                current = next;
+                slot.publish(next);
             }
         }
 
-        close(sock);
+        // Park the workers before the socket they submit to is closed
+        slot.publish(nullptr);
+        {
+            lock_guard<mutex> lock(send_mutex);
+            close(sock);
+        }
         cerr << "Disconnected from server, retrying in 5s...\n";
         this_thread::sleep_for(chrono::seconds(5));
     }
 
+    for (auto& t : workers) t.join();
     return 0;
 }
\ No newline at end of file
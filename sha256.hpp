@@ -0,0 +1,238 @@
+// sha256.hpp
+// Portable SHA-256 compression core used by the mining hot loops.
+// The 80-byte block header is split into two 64-byte blocks: the first one
+// (version, prev hash, first 28 bytes of the merkle root) never changes while
+// the nonce sweeps, so its compression result (the "midstate") is computed
+// once per template. Per nonce only the 16-byte tail block and the second
+// SHA-256 of the 32-byte digest are compressed.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+// ========== Byte Order Helpers ==========
+inline uint32_t readBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline void writeBE32(uint8_t* p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+inline uint32_t bswap32(uint32_t v) {
+    return __builtin_bswap32(v);
+}
+
+// ========== SHA-256 Round Functions ==========
+inline uint32_t rotr32(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+inline uint32_t sha256Ch(uint32_t e, uint32_t f, uint32_t g) { return g ^ (e & (f ^ g)); }
+inline uint32_t sha256Maj(uint32_t a, uint32_t b, uint32_t c) { return (a & b) | (c & (a | b)); }
+inline uint32_t sha256Sigma0(uint32_t a) { return rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22); }
+inline uint32_t sha256Sigma1(uint32_t e) { return rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25); }
+inline uint32_t sha256sigma0(uint32_t w) { return rotr32(w, 7) ^ rotr32(w, 18) ^ (w >> 3); }
+inline uint32_t sha256sigma1(uint32_t w) { return rotr32(w, 17) ^ rotr32(w, 19) ^ (w >> 10); }
+
+// ========== Compression (16 message words, big-endian already decoded) ==========
+inline void sha256Compress(uint32_t state[8], const uint32_t block[16]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) w[i] = block[i];
+    for (int i = 16; i < 64; ++i) {
+        w[i] = sha256sigma1(w[i - 2]) + w[i - 7] + sha256sigma0(w[i - 15]) + w[i - 16];
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + sha256Sigma1(e) + sha256Ch(e, f, g) + SHA256_K[i] + w[i];
+        uint32_t t2 = sha256Sigma0(a) + sha256Maj(a, b, c);
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+inline void sha256CompressBytes(uint32_t state[8], const uint8_t block[64]) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; ++i) w[i] = readBE32(block + 4 * i);
+    sha256Compress(state, w);
+}
+
+// ========== Whole Messages ==========
+typedef void (*Sha256TransformFn)(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+inline void sha256Transform(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    for (; blocks > 0; --blocks, data += 64) sha256CompressBytes(state, data);
+}
+
+// SHA-256 of a message whose first `prefixLen` bytes (whole blocks) are
+// already folded into `midstate`; `data` is the rest of the message.
+inline void sha256DigestFrom(Sha256TransformFn transform, const uint32_t midstate[8], uint64_t prefixLen,
+                             const uint8_t* data, size_t len, uint8_t out[32]) {
+    uint32_t state[8];
+    memcpy(state, midstate, sizeof(state));
+    size_t full = len / 64;
+    if (full) transform(state, data, full);
+
+    uint8_t tail[128] = {0};
+    size_t rem = len - full * 64;
+    memcpy(tail, data + full * 64, rem);
+    tail[rem] = 0x80;
+    size_t tailBlocks = rem + 9 <= 64 ? 1 : 2;
+    uint64_t bits = (prefixLen + len) * 8;
+    for (int i = 0; i < 8; ++i) tail[tailBlocks * 64 - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    transform(state, tail, tailBlocks);
+
+    for (int i = 0; i < 8; ++i) writeBE32(out + 4 * i, state[i]);
+}
+
+// Full SHA-256 (padding + length) on top of any block transform.
+inline void sha256Digest(Sha256TransformFn transform, const uint8_t* data, size_t len, uint8_t out[32]) {
+    sha256DigestFrom(transform, SHA256_IV, 0, data, len, out);
+}
+
+// ========== Header Midstate ==========
+// Nonce-free part of the second header block. Only W3 (the nonce) varies;
+// W0..W2 are fixed per template and W4..W15 are padding, so rounds 0..2 and
+// most message-schedule terms can be computed once per job.
+struct HeaderPrecomp {
+    uint32_t r2[8];   // state after rounds 0..1 (SHA-NI resumes here)
+    uint32_t r3[8];   // state after rounds 0..2
+    uint32_t a4, e4;  // round 3 outputs minus W3
+    uint32_t w16, w17;
+    uint32_t w18;     // W18 - sigma0(W3)
+    uint32_t w19;     // W19 - W3
+    uint32_t w31;     // sigma0(W16) + W15, the nonce-free part of W31
+    uint32_t w32;     // sigma0(W17) + W16, the nonce-free part of W32
+};
+
+// Everything about an 80-byte header that stays fixed while the nonce sweeps.
+struct HeaderJob {
+    uint32_t midstate[8];  // SHA-256 state after header bytes 0..63
+    uint32_t tail[3];      // header bytes 64..75 (merkle tail, ntime, bits) as BE words
+    uint32_t target[8];    // 256-bit target as BE words, target[0] most significant
+    HeaderPrecomp pre;
+};
+
+inline void sha256Round(uint32_t s[8], int i, uint32_t w) {
+    uint32_t t1 = s[7] + sha256Sigma1(s[4]) + sha256Ch(s[4], s[5], s[6]) + SHA256_K[i] + w;
+    uint32_t t2 = sha256Sigma0(s[0]) + sha256Maj(s[0], s[1], s[2]);
+    s[7] = s[6]; s[6] = s[5]; s[5] = s[4]; s[4] = s[3] + t1;
+    s[3] = s[2]; s[2] = s[1]; s[1] = s[0]; s[0] = t1 + t2;
+}
+
+inline void precomputeHeaderTail(HeaderJob& job) {
+    HeaderPrecomp& p = job.pre;
+    const uint32_t* w = job.tail;
+    uint32_t s[8];
+    memcpy(s, job.midstate, sizeof(s));
+    sha256Round(s, 0, w[0]);
+    sha256Round(s, 1, w[1]);
+    memcpy(p.r2, s, sizeof(s));
+    sha256Round(s, 2, w[2]);
+    memcpy(p.r3, s, sizeof(s));
+
+    uint32_t t1 = s[7] + sha256Sigma1(s[4]) + sha256Ch(s[4], s[5], s[6]) + SHA256_K[3];
+    uint32_t t2 = sha256Sigma0(s[0]) + sha256Maj(s[0], s[1], s[2]);
+    p.a4 = t1 + t2;
+    p.e4 = s[3] + t1;
+
+    p.w16 = sha256sigma0(w[1]) + w[0];
+    p.w17 = sha256sigma1(80 * 8) + sha256sigma0(w[2]) + w[1];
+    p.w18 = sha256sigma1(p.w16) + w[2];
+    p.w19 = sha256sigma1(p.w17) + sha256sigma0(0x80000000);
+    p.w31 = sha256sigma0(p.w16) + 80 * 8;
+    p.w32 = sha256sigma0(p.w17) + p.w16;
+}
+
+// Move a prepared job to another ntime (header bytes 68..71). ntime is in the
+// second block, so the midstate stays valid and only the tail precompute
+// (three rounds and a few schedule terms) is redone.
+inline void setHeaderJobTime(HeaderJob& job, uint32_t ntime) {
+    job.tail[1] = bswap32(ntime);
+    precomputeHeaderTail(job);
+}
+
+inline HeaderJob prepareHeaderJob(const uint8_t header[80], const uint8_t targetBE[32]) {
+    HeaderJob job;
+    memcpy(job.midstate, SHA256_IV, sizeof(job.midstate));
+    sha256CompressBytes(job.midstate, header);
+    for (int i = 0; i < 3; ++i) job.tail[i] = readBE32(header + 64 + 4 * i);
+    for (int i = 0; i < 8; ++i) job.target[i] = readBE32(targetBE + 4 * i);
+    precomputeHeaderTail(job);
+    return job;
+}
+
+// Double SHA-256 of the header with `nonce` at bytes 76..79 (little-endian,
+// as writeLE32 stores it). Returns the raw state words of the second hash;
+// digest byte i is byte (i % 4) of the big-endian word out[i / 4].
+inline void hashHeaderNonce(const HeaderJob& job, uint32_t nonce, uint32_t out[8]) {
+    uint32_t block[16] = {
+        job.tail[0], job.tail[1], job.tail[2], bswap32(nonce),
+        0x80000000, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 80 * 8
+    };
+    uint32_t state[8];
+    memcpy(state, job.midstate, sizeof(state));
+    sha256Compress(state, block);
+
+    uint32_t block2[16] = {
+        state[0], state[1], state[2], state[3], state[4], state[5], state[6], state[7],
+        0x80000000, 0, 0, 0, 0, 0, 0, 32 * 8
+    };
+    memcpy(out, SHA256_IV, 8 * sizeof(uint32_t));
+    sha256Compress(out, block2);
+}
+
+// Block hash as a big-endian 256-bit number (the byte-reversed digest, i.e.
+// the form bitcoind prints and the form compared against the target).
+inline void headerHashToBE(const uint32_t h[8], uint8_t out[32]) {
+    for (int i = 0; i < 8; ++i) {
+        uint32_t le = bswap32(h[7 - i]);
+        writeBE32(out + 4 * i, le);
+    }
+}
+
+// Compare the raw second-hash state against the job target, most significant
+// word first (bswap(h[7]) is the top 32 bits of the block hash).
+inline bool headerHashMeetsTarget(const uint32_t h[8], const uint32_t target[8]) {
+    for (int i = 0; i < 8; ++i) {
+        uint32_t w = bswap32(h[7 - i]);
+        if (w != target[i]) return w < target[i];
+    }
+    return false;
+}
+
+// Kernels only check the top hash word; this runs the full hash for each
+// candidate lane in `mask` and returns the first real hit.
+inline bool confirmHeaderHit(const HeaderJob& job, uint32_t nonceBase, uint32_t mask,
+                             uint32_t& nonce, uint32_t h[8]) {
+    while (mask) {
+        nonce = nonceBase + __builtin_ctz(mask);
+        mask &= mask - 1;
+        hashHeaderNonce(job, nonce, h);
+        if (headerHashMeetsTarget(h, job.target)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,262 @@
+// sha256_dispatch.hpp
+// Runtime kernel selection. One binary is shipped to every host, so the
+// kernels are all compiled in and the best one is picked at startup from
+// CPUID/XGETBV. A kernel is only trusted after it reproduces OpenSSL's
+// output on a small known-answer set; a failing kernel is skipped and the
+// next one down the list is tried.
+
+#pragma once
+
+#include "sha256.hpp"
+#include "sha256_simd.hpp"
+#include "sha256_shani.hpp"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <openssl/sha.h>
+
+#ifdef SHA256_HAVE_X86
+#include <cpuid.h>
+#endif
+
+// ========== CPU Features ==========
+struct CpuFeatures {
+    bool sse41 = false;
+    bool avx2 = false;
+    bool avx512f = false;
+    bool shani = false;
+};
+
+inline CpuFeatures detectCpuFeatures() {
+    CpuFeatures f;
+#ifdef SHA256_HAVE_X86
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return f;
+    f.sse41 = (c & (1u << 19)) != 0;
+    bool osxsave = (c & (1u << 27)) != 0;
+    bool avx = (c & (1u << 28)) != 0;
+
+    // The OS must save YMM (XCR0 bits 1,2) / ZMM (bits 5,6,7) state on
+    // context switches, otherwise the wide kernels corrupt each other.
+    uint64_t xcr0 = 0;
+    if (osxsave) {
+        uint32_t lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = (static_cast<uint64_t>(hi) << 32) | lo;
+    }
+    bool ymmOs = (xcr0 & 0x06) == 0x06;
+    bool zmmOs = (xcr0 & 0xe6) == 0xe6;
+
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d)) {
+        f.avx2 = avx && ymmOs && (b & (1u << 5));
+        f.avx512f = zmmOs && (b & (1u << 16));
+        f.shani = f.sse41 && (b & (1u << 29));
+    }
+#endif
+    return f;
+}
+
+inline std::string cpuFeatureString(const CpuFeatures& f) {
+    std::string s;
+    if (f.sse41) s += " sse4.1";
+    if (f.avx2) s += " avx2";
+    if (f.avx512f) s += " avx512f";
+    if (f.shani) s += " sha-ni";
+    return s.empty() ? "none" : s.substr(1);
+}
+
+// ========== Single-Message Kernels ==========
+typedef void (*Sha256DigestFn)(const uint8_t* data, size_t len, uint8_t out[32]);
+
+// `transform` is the same kernel's block function, for callers that keep
+// their own midstate (pool_pow.hpp). OpenSSL has no public one, so the
+// fallback entry is named "portable" after its transform (the part the hot
+// loops run); its single-message digest still goes through OpenSSL.
+struct Sha256Kernel {
+    const char* name;
+    Sha256DigestFn digest;
+    Sha256TransformFn transform;
+};
+
+inline void sha256OpenSSL(const uint8_t* data, size_t len, uint8_t out[32]) {
+    SHA256(data, len, out);
+}
+
+// ========== Known-Answer Self-Tests ==========
+inline bool selfTestSha256Kernel(const Sha256Kernel& k) {
+    std::mt19937 rng(0x5eed);
+    std::vector<uint8_t> msg(200);
+    for (auto& b : msg) b = static_cast<uint8_t>(rng());
+    for (size_t len = 0; len <= msg.size(); ++len) {
+        uint8_t want[32], got[32];
+        SHA256(msg.data(), len, want);
+        k.digest(msg.data(), len, got);
+        if (memcmp(want, got, 32) != 0) return false;
+        sha256Digest(k.transform, msg.data(), len, got);
+        if (memcmp(want, got, 32) != 0) return false;
+    }
+    return true;
+}
+
+inline bool selfTestHeaderScanner(const HeaderScanner& s) {
+    std::mt19937 rng(0xb10c);
+    for (int trial = 0; trial < 8; ++trial) {
+        uint8_t header[80];
+        for (auto& b : header) b = static_cast<uint8_t>(rng());
+        uint32_t nonceBase = rng();
+
+        // Reference hashes (big-endian) straight from OpenSSL.
+        std::vector<std::vector<uint8_t>> ref(s.lanes, std::vector<uint8_t>(32));
+        for (int lane = 0; lane < s.lanes; ++lane) {
+            uint32_t nonce = nonceBase + lane;
+            header[76] = nonce; header[77] = nonce >> 8; header[78] = nonce >> 16; header[79] = nonce >> 24;
+            uint8_t h1[32], h2[32];
+            SHA256(header, 80, h1);
+            SHA256(h1, 32, h2);
+            for (int i = 0; i < 32; ++i) ref[lane][i] = h2[31 - i];
+        }
+
+        // Targets that pass every lane, no lane, and one lane's own hash.
+        // Kernels report candidates by the top hash word (<=), so the
+        // expected mask is computed the same way.
+        std::vector<std::vector<uint8_t>> targets;
+        targets.push_back(std::vector<uint8_t>(32, 0xff));
+        targets.push_back(std::vector<uint8_t>(32, 0x00));
+        targets.push_back(ref[trial % s.lanes]);
+        for (const auto& target : targets) {
+            uint32_t want = 0;
+            for (int lane = 0; lane < s.lanes; ++lane) {
+                if (memcmp(ref[lane].data(), target.data(), 4) <= 0) want |= 1u << lane;
+            }
+            HeaderJob job = prepareHeaderJob(header, target.data());
+            if (s.scan(job, nonceBase) != want) return false;
+        }
+    }
+    return true;
+}
+
+inline bool selfTestMidstateBatcher(const MidstateBatcher& m) {
+    std::mt19937 rng(0x320);
+    for (int trial = 0; trial < 4; ++trial) {
+        uint8_t header[64];
+        for (auto& b : header) b = static_cast<uint8_t>(rng());
+        uint32_t block[16], w0[16], out[8 * 16];
+        for (int i = 0; i < 16; ++i) block[i] = readBE32(header + 4 * i);
+        for (int lane = 0; lane < m.lanes; ++lane) w0[lane] = rng();
+        m.midstates(w0, block, out);
+        for (int lane = 0; lane < m.lanes; ++lane) {
+            uint32_t want[8];
+            memcpy(want, SHA256_IV, sizeof(want));
+            header[0] = w0[lane] >> 24; header[1] = w0[lane] >> 16; header[2] = w0[lane] >> 8; header[3] = w0[lane];
+            sha256CompressBytes(want, header);
+            for (int i = 0; i < 8; ++i) {
+                if (out[i * m.lanes + lane] != want[i]) return false;
+            }
+        }
+    }
+    return true;
+}
+
+inline bool selfTestPairHasher(const PairHasher& h) {
+    std::mt19937 rng(0x3e4c1e);
+    for (int trial = 0; trial < 4; ++trial) {
+        uint8_t pairs[64 * 16], out[32 * 16], want[32];
+        for (auto& b : pairs) b = static_cast<uint8_t>(rng());
+        h.hash(pairs, out);
+        for (int lane = 0; lane < h.lanes; ++lane) {
+            SHA256(pairs + 64 * lane, 64, want);
+            SHA256(want, 32, want);
+            if (memcmp(out + 32 * lane, want, 32) != 0) return false;
+        }
+        // In place, as merkle levels are built
+        h.hash(pairs, pairs);
+        if (memcmp(pairs, out, 32 * h.lanes) != 0) return false;
+    }
+    return true;
+}
+
+// ========== Selection ==========
+// Best-first; the scalar entries always exist as a last resort.
+inline std::vector<HeaderScanner> headerScannerCandidates(const CpuFeatures& f) {
+    std::vector<HeaderScanner> out;
+#ifdef SHA256_HAVE_X86
+    if (f.avx512f) out.push_back(HeaderScanner{"avx512f", 16, scanHeaderAvx512});
+#endif
+#ifdef SHA256_HAVE_SHANI
+    if (f.shani) out.push_back(HeaderScanner{"sha-ni", 2, scanHeaderShani});
+#endif
+#ifdef SHA256_HAVE_X86
+    if (f.avx2) out.push_back(HeaderScanner{"avx2", 8, scanHeaderAvx2});
+    if (f.sse41) out.push_back(HeaderScanner{"sse4.1", 4, scanHeaderSse41});
+#endif
+    out.push_back(HeaderScanner{"scalar", 1, scanHeaderScalar});
+    return out;
+}
+
+inline std::vector<Sha256Kernel> sha256KernelCandidates(const CpuFeatures& f) {
+    std::vector<Sha256Kernel> out;
+#ifdef SHA256_HAVE_SHANI
+    if (f.shani) out.push_back(Sha256Kernel{"sha-ni", sha256Shani, sha256TransformShani});
+#endif
+    out.push_back(Sha256Kernel{"portable", sha256OpenSSL, sha256Transform});
+    return out;
+}
+
+// Every candidate that passes its self-test, best-first
+inline std::vector<HeaderScanner> passingHeaderScanners() {
+    std::vector<HeaderScanner> out;
+    for (const auto& s : headerScannerCandidates(detectCpuFeatures())) {
+        if (selfTestHeaderScanner(s)) out.push_back(s);
+        else std::cerr << "SHA256d kernel " << s.name << " failed self-test, skipping\n";
+    }
+    if (out.empty()) out.push_back(HeaderScanner{"scalar", 1, scanHeaderScalar});
+    return out;
+}
+
+inline std::vector<MidstateBatcher> midstateBatcherCandidates(const CpuFeatures& f) {
+    std::vector<MidstateBatcher> out;
+#ifdef SHA256_HAVE_X86
+    if (f.avx512f) out.push_back(MidstateBatcher{"avx512f", 16, midstatesAvx512});
+    if (f.avx2) out.push_back(MidstateBatcher{"avx2", 8, midstatesAvx2});
+    if (f.sse41) out.push_back(MidstateBatcher{"sse4.1", 4, midstatesSse41});
+#endif
+    out.push_back(MidstateBatcher{"scalar", 1, midstatesScalar});
+    return out;
+}
+
+inline MidstateBatcher selectMidstateBatcher() {
+    for (const auto& m : midstateBatcherCandidates(detectCpuFeatures())) {
+        if (selfTestMidstateBatcher(m)) return m;
+        std::cerr << "Midstate kernel " << m.name << " failed self-test, skipping\n";
+    }
+    return MidstateBatcher{"scalar", 1, midstatesScalar};
+}
+
+inline std::vector<PairHasher> pairHasherCandidates(const CpuFeatures& f) {
+    std::vector<PairHasher> out;
+#ifdef SHA256_HAVE_X86
+    if (f.avx512f) out.push_back(PairHasher{"avx512f", 16, hashPairsAvx512});
+    if (f.avx2) out.push_back(PairHasher{"avx2", 8, hashPairsAvx2});
+    if (f.sse41) out.push_back(PairHasher{"sse4.1", 4, hashPairsSse41});
+#endif
+    out.push_back(PairHasher{"scalar", 1, hashPairsScalar});
+    return out;
+}
+
+inline PairHasher selectPairHasher() {
+    for (const auto& h : pairHasherCandidates(detectCpuFeatures())) {
+        if (selfTestPairHasher(h)) return h;
+        std::cerr << "Merkle pair kernel " << h.name << " failed self-test, skipping\n";
+    }
+    return PairHasher{"scalar", 1, hashPairsScalar};
+}
+
+inline Sha256Kernel selectSha256Kernel() {
+    for (const auto& k : sha256KernelCandidates(detectCpuFeatures())) {
+        if (selfTestSha256Kernel(k)) return k;
+        std::cerr << "SHA256 kernel " << k.name << " failed self-test, skipping\n";
+    }
+    return Sha256Kernel{"portable", sha256OpenSSL, sha256Transform};
+}
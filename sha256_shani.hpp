@@ -0,0 +1,178 @@
+// sha256_shani.hpp
+// SHA-256 on the Intel SHA extensions (sha256rnds2/sha256msg1/sha256msg2).
+// A single stream is latency bound: each sha256rnds2 depends on the previous
+// one. The header kernel therefore runs two nonces through the rounds side by
+// side so the second stream fills the first one's pipeline bubbles.
+
+#pragma once
+
+#include "sha256.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA256_HAVE_SHANI 1
+#include <immintrin.h>
+#endif
+
+#ifdef SHA256_HAVE_SHANI
+
+#define SHA256_TARGET_SHANI __attribute__((target("sha,sse4.1")))
+
+namespace sha256_shani {
+
+typedef __m128i V;
+
+SHA256_TARGET_SHANI inline V LoadBE(const uint8_t* p) {
+    const V mask = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const V*>(p)), mask);
+}
+
+SHA256_TARGET_SHANI inline V KQuad(int q) {
+    return _mm_loadu_si128(reinterpret_cast<const V*>(SHA256_K + 4 * q));
+}
+
+// state words a..h <-> the ABEF / CDGH register pair sha256rnds2 expects.
+SHA256_TARGET_SHANI inline void Shuffle(V& s0, V& s1) {
+    V t1 = _mm_shuffle_epi32(s0, 0xb1);
+    V t2 = _mm_shuffle_epi32(s1, 0x1b);
+    s0 = _mm_alignr_epi8(t1, t2, 8);
+    s1 = _mm_blend_epi16(t2, t1, 0xf0);
+}
+
+SHA256_TARGET_SHANI inline void Unshuffle(V& s0, V& s1) {
+    V t1 = _mm_shuffle_epi32(s0, 0x1b);
+    V t2 = _mm_shuffle_epi32(s1, 0xb1);
+    s0 = _mm_blend_epi16(t1, t2, 0xf0);
+    s1 = _mm_alignr_epi8(t2, t1, 8);
+}
+
+// Message quad j >= 4 from quads j-4..j-1 (m[j & 3] holds quad j-4).
+SHA256_TARGET_SHANI inline void Schedule(V m[4], int j) {
+    V w4 = m[j & 3], w3 = m[(j + 1) & 3], w2 = m[(j + 2) & 3], w1 = m[(j + 3) & 3];
+    V t = _mm_add_epi32(_mm_sha256msg1_epu32(w4, w3), _mm_alignr_epi8(w1, w2, 4));
+    m[j & 3] = _mm_sha256msg2_epu32(t, w1);
+}
+
+SHA256_TARGET_SHANI inline void QuadRound(V& s0, V& s1, V msg) {
+    s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+    s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+// One block on shuffled state; m[] holds the 16 message words as 4 quads.
+SHA256_TARGET_SHANI inline void Compress(V& s0, V& s1, V m[4]) {
+    V so0 = s0, so1 = s1;
+#pragma GCC unroll 16
+    for (int j = 0; j < 16; ++j) {
+        if (j >= 4) Schedule(m, j);
+        QuadRound(s0, s1, _mm_add_epi32(m[j & 3], KQuad(j)));
+    }
+    s0 = _mm_add_epi32(s0, so0);
+    s1 = _mm_add_epi32(s1, so1);
+}
+
+// Two independent blocks with their rounds interleaved. With skip01 the
+// states already include rounds 0-1 (a1/b1 = ABEF, a0/b0 = CDGH, which is
+// where the first sha256rnds2 would have left them). With skip6263 the last
+// sha256rnds2 is dropped and a1/b1 hold ABEF after round 61, whose F is
+// already the final h.
+SHA256_TARGET_SHANI inline void Rounds2(V& a0, V& a1, V ma[4], V& b0, V& b1, V mb[4],
+                                        bool skip01, bool skip6263) {
+#pragma GCC unroll 16
+    for (int j = 0; j < 16; ++j) {
+        if (j >= 4) {
+            Schedule(ma, j);
+            Schedule(mb, j);
+        }
+        V k = KQuad(j);
+        V wa = _mm_add_epi32(ma[j & 3], k);
+        V wb = _mm_add_epi32(mb[j & 3], k);
+        if (j > 0 || !skip01) {
+            a1 = _mm_sha256rnds2_epu32(a1, a0, wa);
+            b1 = _mm_sha256rnds2_epu32(b1, b0, wb);
+        }
+        if (j < 15 || !skip6263) {
+            a0 = _mm_sha256rnds2_epu32(a0, a1, _mm_shuffle_epi32(wa, 0x0e));
+            b0 = _mm_sha256rnds2_epu32(b0, b1, _mm_shuffle_epi32(wb, 0x0e));
+        }
+    }
+}
+
+SHA256_TARGET_SHANI inline void Compress2(V& a0, V& a1, V ma[4], V& b0, V& b1, V mb[4]) {
+    V ao0 = a0, ao1 = a1, bo0 = b0, bo1 = b1;
+    Rounds2(a0, a1, ma, b0, b1, mb, false, false);
+    a0 = _mm_add_epi32(a0, ao0); a1 = _mm_add_epi32(a1, ao1);
+    b0 = _mm_add_epi32(b0, bo0); b1 = _mm_add_epi32(b1, bo1);
+}
+
+SHA256_TARGET_SHANI inline void Transform(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    V s0 = _mm_loadu_si128(reinterpret_cast<const V*>(state));
+    V s1 = _mm_loadu_si128(reinterpret_cast<const V*>(state + 4));
+    Shuffle(s0, s1);
+    for (; blocks > 0; --blocks, data += 64) {
+        V m[4] = { LoadBE(data), LoadBE(data + 16), LoadBE(data + 32), LoadBE(data + 48) };
+        Compress(s0, s1, m);
+    }
+    Unshuffle(s0, s1);
+    _mm_storeu_si128(reinterpret_cast<V*>(state), s0);
+    _mm_storeu_si128(reinterpret_cast<V*>(state + 4), s1);
+}
+
+// Nonces nonceBase and nonceBase + 1 through both SHA-256 passes. Rounds
+// 0-1 of the second header block only see W0/W1 and come from the job.
+SHA256_TARGET_SHANI inline uint32_t ScanHeader(const HeaderJob& job, uint32_t nonceBase) {
+    V mid0 = _mm_loadu_si128(reinterpret_cast<const V*>(job.midstate));
+    V mid1 = _mm_loadu_si128(reinterpret_cast<const V*>(job.midstate + 4));
+    Shuffle(mid0, mid1);
+    V r20 = _mm_loadu_si128(reinterpret_cast<const V*>(job.pre.r2));
+    V r21 = _mm_loadu_si128(reinterpret_cast<const V*>(job.pre.r2 + 4));
+    Shuffle(r20, r21);
+    V iv0 = _mm_loadu_si128(reinterpret_cast<const V*>(SHA256_IV));
+    V iv1 = _mm_loadu_si128(reinterpret_cast<const V*>(SHA256_IV + 4));
+    Shuffle(iv0, iv1);
+
+    const V pad1 = _mm_setr_epi32(static_cast<int>(0x80000000), 0, 0, 0);
+    const V zero = _mm_setzero_si128();
+    V ma[4] = {
+        _mm_setr_epi32(job.tail[0], job.tail[1], job.tail[2], bswap32(nonceBase)),
+        pad1, zero, _mm_setr_epi32(0, 0, 0, 80 * 8)
+    };
+    V mb[4] = {
+        _mm_setr_epi32(job.tail[0], job.tail[1], job.tail[2], bswap32(nonceBase + 1)),
+        pad1, zero, _mm_setr_epi32(0, 0, 0, 80 * 8)
+    };
+    V a0 = r21, a1 = r20, b0 = r21, b1 = r20;
+    Rounds2(a0, a1, ma, b0, b1, mb, true, false);
+    a0 = _mm_add_epi32(a0, mid0); a1 = _mm_add_epi32(a1, mid1);
+    b0 = _mm_add_epi32(b0, mid0); b1 = _mm_add_epi32(b1, mid1);
+    Unshuffle(a0, a1);
+    Unshuffle(b0, b1);
+
+    // The first digest (natural word order) is the second block's W0..W7.
+    const V len2 = _mm_setr_epi32(0, 0, 0, 32 * 8);
+    V ma2[4] = { a0, a1, pad1, len2 };
+    V mb2[4] = { b0, b1, pad1, len2 };
+    a0 = iv0; a1 = iv1; b0 = iv0; b1 = iv1;
+    Rounds2(a0, a1, ma2, b0, b1, mb2, false, true);
+
+    // Same early exit as the lane kernels: only the top hash word is checked.
+    uint32_t ha7 = static_cast<uint32_t>(_mm_cvtsi128_si32(a1)) + SHA256_IV[7];
+    uint32_t hb7 = static_cast<uint32_t>(_mm_cvtsi128_si32(b1)) + SHA256_IV[7];
+    return (bswap32(ha7) <= job.target[0] ? 1u : 0u) |
+           (bswap32(hb7) <= job.target[0] ? 2u : 0u);
+}
+
+} // namespace sha256_shani
+
+inline void sha256TransformShani(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    sha256_shani::Transform(state, data, blocks);
+}
+
+inline uint32_t scanHeaderShani(const HeaderJob& job, uint32_t nonceBase) {
+    return sha256_shani::ScanHeader(job, nonceBase);
+}
+
+// Single-shot SHA-256 of a short message (pool_worker's data + nonce string).
+inline void sha256Shani(const uint8_t* data, size_t len, uint8_t out[32]) {
+    sha256Digest(sha256TransformShani, data, len, out);
+}
+
+#endif // SHA256_HAVE_SHANI
@@ -0,0 +1,293 @@
+// sha256_simd.hpp
+// Multi-lane SHA256d header kernels: each 32-bit lane hashes the same
+// HeaderJob with a different nonce (nonceBase + lane). A scan returns a
+// bitmask of candidate lanes whose top hash word is within the target's;
+// callers confirm them with confirmHeaderHit() before submitting anything.
+// Kernels are compiled with per-function target attributes, so the binary
+// itself does not need -mavx2 and runs on any x86-64 box. The round and
+// schedule code is shared through sha256_lanes.inc; each namespace below
+// only supplies the primitives for its register width. The same lanes also
+// build first-block midstates for BIP320 version rolling (one version per
+// lane, see Midstates) and merkle nodes (one sibling pair per lane, see
+// HashPairs).
+
+#pragma once
+
+#include "sha256.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA256_HAVE_X86 1
+#include <immintrin.h>
+#endif
+
+typedef uint32_t (*HeaderScanFn)(const HeaderJob& job, uint32_t nonceBase);
+
+struct HeaderScanner {
+    const char* name;
+    int lanes;
+    HeaderScanFn scan;
+};
+
+// Midstates of `lanes` first header blocks that differ only in message word
+// 0 (the version): w0[lane] is that lane's word 0, block[1..15] the rest, all
+// as big-endian message words. Writes state word i of lane l to out[i * lanes + l].
+typedef void (*MidstateBatchFn)(const uint32_t* w0, const uint32_t block[16], uint32_t* out);
+
+struct MidstateBatcher {
+    const char* name;
+    int lanes;
+    MidstateBatchFn midstates;
+};
+
+// SHA256d of `lanes` 64-byte messages at pairs + 64 * l; digest l goes to
+// out + 32 * l. All input is read before anything is written, so `out` may
+// overlap `pairs`.
+typedef void (*PairHashFn)(const uint8_t* pairs, uint8_t* out);
+
+struct PairHasher {
+    const char* name;
+    int lanes;
+    PairHashFn hash;
+};
+
+// ========== Scalar: 1 lane ==========
+namespace sha256_scalar {
+
+typedef uint32_t V;
+#define SHA256_LANE_TARGET
+
+inline V K(uint32_t x) { return x; }
+inline V Add(V a, V b) { return a + b; }
+inline V Ch(V e, V f, V g) { return sha256Ch(e, f, g); }
+inline V Maj(V a, V b, V c) { return sha256Maj(a, b, c); }
+inline V Sigma0(V a) { return sha256Sigma0(a); }
+inline V Sigma1(V e) { return sha256Sigma1(e); }
+inline V sigma0(V w) { return sha256sigma0(w); }
+inline V sigma1(V w) { return sha256sigma1(w); }
+inline V Bswap(V x) { return bswap32(x); }
+inline V LaneOffsets() { return 0; }
+inline V Load(const uint32_t* p) { return *p; }
+inline void Store(uint32_t* p, V v) { *p = v; }
+inline uint32_t TopWordMask(V h7, uint32_t targetTop) {
+    return bswap32(h7) <= targetTop ? 1u : 0u;
+}
+
+#include "sha256_lanes.inc"
+#undef SHA256_LANE_TARGET
+
+} // namespace sha256_scalar
+
+inline uint32_t scanHeaderScalar(const HeaderJob& job, uint32_t nonceBase) {
+    return sha256_scalar::ScanHeader(job, nonceBase);
+}
+
+inline void midstatesScalar(const uint32_t* w0, const uint32_t block[16], uint32_t* out) {
+    sha256_scalar::Midstates(w0, block, out);
+}
+
+inline void hashPairsScalar(const uint8_t* pairs, uint8_t* out) {
+    sha256_scalar::HashPairs(pairs, out);
+}
+
+#ifdef SHA256_HAVE_X86
+
+#define SHA256_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SHA256_TARGET_AVX2  __attribute__((target("avx2")))
+#define SHA256_TARGET_AVX512 __attribute__((target("avx512f")))
+
+// ========== SSE4.1: 4 lanes ==========
+namespace sha256_sse41 {
+
+typedef __m128i V;
+#define SHA256_LANE_TARGET SHA256_TARGET_SSE41
+
+SHA256_TARGET_SSE41 inline V K(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+SHA256_TARGET_SSE41 inline V Add(V a, V b) { return _mm_add_epi32(a, b); }
+SHA256_TARGET_SSE41 inline V Sub(V a, V b) { return _mm_sub_epi32(a, b); }
+SHA256_TARGET_SSE41 inline V Xor(V a, V b) { return _mm_xor_si128(a, b); }
+SHA256_TARGET_SSE41 inline V Xor(V a, V b, V c) { return Xor(Xor(a, b), c); }
+SHA256_TARGET_SSE41 inline V And(V a, V b) { return _mm_and_si128(a, b); }
+SHA256_TARGET_SSE41 inline V Or(V a, V b) { return _mm_or_si128(a, b); }
+SHA256_TARGET_SSE41 inline V ShR(V x, int n) { return _mm_srli_epi32(x, n); }
+SHA256_TARGET_SSE41 inline V ShL(V x, int n) { return _mm_slli_epi32(x, n); }
+SHA256_TARGET_SSE41 inline V RotR(V x, int n) { return Or(ShR(x, n), ShL(x, 32 - n)); }
+
+SHA256_TARGET_SSE41 inline V Ch(V e, V f, V g) { return Xor(g, And(e, Xor(f, g))); }
+SHA256_TARGET_SSE41 inline V Maj(V a, V b, V c) { return Or(And(a, b), And(c, Or(a, b))); }
+SHA256_TARGET_SSE41 inline V Sigma0(V a) { return Xor(RotR(a, 2), RotR(a, 13), RotR(a, 22)); }
+SHA256_TARGET_SSE41 inline V Sigma1(V e) { return Xor(RotR(e, 6), RotR(e, 11), RotR(e, 25)); }
+SHA256_TARGET_SSE41 inline V sigma0(V w) { return Xor(RotR(w, 7), RotR(w, 18), ShR(w, 3)); }
+SHA256_TARGET_SSE41 inline V sigma1(V w) { return Xor(RotR(w, 17), RotR(w, 19), ShR(w, 10)); }
+
+SHA256_TARGET_SSE41 inline V Bswap(V x) {
+    return _mm_shuffle_epi8(x, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+}
+
+SHA256_TARGET_SSE41 inline V LaneOffsets() { return _mm_setr_epi32(0, 1, 2, 3); }
+SHA256_TARGET_SSE41 inline V Load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+SHA256_TARGET_SSE41 inline void Store(uint32_t* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+
+// Lanes with bswap(h7) <= targetTop. At real difficulty targetTop is 0 and
+// the test is a plain compare against zero, no byte swap needed.
+SHA256_TARGET_SSE41 inline uint32_t TopWordMask(V h7, uint32_t targetTop) {
+    V hit;
+    if (targetTop == 0) {
+        hit = _mm_cmpeq_epi32(h7, K(0));
+    } else {
+        V top = Bswap(h7);  // unsigned top <= targetTop  <=>  min(top, targetTop) == top
+        hit = _mm_cmpeq_epi32(_mm_min_epu32(top, K(targetTop)), top);
+    }
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(hit)));
+}
+
+#include "sha256_lanes.inc"
+#undef SHA256_LANE_TARGET
+
+} // namespace sha256_sse41
+
+// ========== AVX2: 8 lanes ==========
+namespace sha256_avx2 {
+
+typedef __m256i V;
+#define SHA256_LANE_TARGET SHA256_TARGET_AVX2
+
+SHA256_TARGET_AVX2 inline V K(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+SHA256_TARGET_AVX2 inline V Add(V a, V b) { return _mm256_add_epi32(a, b); }
+SHA256_TARGET_AVX2 inline V Sub(V a, V b) { return _mm256_sub_epi32(a, b); }
+SHA256_TARGET_AVX2 inline V Xor(V a, V b) { return _mm256_xor_si256(a, b); }
+SHA256_TARGET_AVX2 inline V Xor(V a, V b, V c) { return Xor(Xor(a, b), c); }
+SHA256_TARGET_AVX2 inline V And(V a, V b) { return _mm256_and_si256(a, b); }
+SHA256_TARGET_AVX2 inline V Or(V a, V b) { return _mm256_or_si256(a, b); }
+SHA256_TARGET_AVX2 inline V ShR(V x, int n) { return _mm256_srli_epi32(x, n); }
+SHA256_TARGET_AVX2 inline V ShL(V x, int n) { return _mm256_slli_epi32(x, n); }
+SHA256_TARGET_AVX2 inline V RotR(V x, int n) { return Or(ShR(x, n), ShL(x, 32 - n)); }
+
+SHA256_TARGET_AVX2 inline V Ch(V e, V f, V g) { return Xor(g, And(e, Xor(f, g))); }
+SHA256_TARGET_AVX2 inline V Maj(V a, V b, V c) { return Or(And(a, b), And(c, Or(a, b))); }
+SHA256_TARGET_AVX2 inline V Sigma0(V a) { return Xor(RotR(a, 2), RotR(a, 13), RotR(a, 22)); }
+SHA256_TARGET_AVX2 inline V Sigma1(V e) { return Xor(RotR(e, 6), RotR(e, 11), RotR(e, 25)); }
+SHA256_TARGET_AVX2 inline V sigma0(V w) { return Xor(RotR(w, 7), RotR(w, 18), ShR(w, 3)); }
+SHA256_TARGET_AVX2 inline V sigma1(V w) { return Xor(RotR(w, 17), RotR(w, 19), ShR(w, 10)); }
+
+SHA256_TARGET_AVX2 inline V Bswap(V x) {
+    return _mm256_shuffle_epi8(x, _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+}
+
+SHA256_TARGET_AVX2 inline V LaneOffsets() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+SHA256_TARGET_AVX2 inline V Load(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+SHA256_TARGET_AVX2 inline void Store(uint32_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+
+SHA256_TARGET_AVX2 inline uint32_t TopWordMask(V h7, uint32_t targetTop) {
+    V hit;
+    if (targetTop == 0) {
+        hit = _mm256_cmpeq_epi32(h7, K(0));
+    } else {
+        V top = Bswap(h7);  // unsigned top <= targetTop  <=>  min(top, targetTop) == top
+        hit = _mm256_cmpeq_epi32(_mm256_min_epu32(top, K(targetTop)), top);
+    }
+    return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(hit)));
+}
+
+#include "sha256_lanes.inc"
+#undef SHA256_LANE_TARGET
+
+} // namespace sha256_avx2
+
+// ========== AVX-512F: 16 lanes ==========
+// Native rotates (vprold) and three-input logic (vpternlogd) replace the
+// shift/or rotate pairs and the two-step Ch/Maj/XOR chains of the AVX2 path.
+// GCC 12 flags _mm512_undefined_epi32() inside its own intrinsics once they
+// are inlined here; the pragma keeps -Wall builds quiet.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+namespace sha256_avx512 {
+
+typedef __m512i V;
+#define SHA256_LANE_TARGET SHA256_TARGET_AVX512
+
+SHA256_TARGET_AVX512 inline V K(uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+SHA256_TARGET_AVX512 inline V Add(V a, V b) { return _mm512_add_epi32(a, b); }
+SHA256_TARGET_AVX512 inline V Sub(V a, V b) { return _mm512_sub_epi32(a, b); }
+SHA256_TARGET_AVX512 inline V And(V a, V b) { return _mm512_and_si512(a, b); }
+SHA256_TARGET_AVX512 inline V Or(V a, V b) { return _mm512_or_si512(a, b); }
+SHA256_TARGET_AVX512 inline V Xor3(V a, V b, V c) { return _mm512_ternarylogic_epi32(a, b, c, 0x96); }
+SHA256_TARGET_AVX512 inline V ShR(V x, int n) { return _mm512_srli_epi32(x, n); }
+SHA256_TARGET_AVX512 inline V ShL(V x, int n) { return _mm512_slli_epi32(x, n); }
+
+SHA256_TARGET_AVX512 inline V Ch(V e, V f, V g) { return _mm512_ternarylogic_epi32(e, f, g, 0xca); }
+SHA256_TARGET_AVX512 inline V Maj(V a, V b, V c) { return _mm512_ternarylogic_epi32(a, b, c, 0xe8); }
+SHA256_TARGET_AVX512 inline V Sigma0(V a) {
+    return Xor3(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13), _mm512_ror_epi32(a, 22));
+}
+SHA256_TARGET_AVX512 inline V Sigma1(V e) {
+    return Xor3(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11), _mm512_ror_epi32(e, 25));
+}
+SHA256_TARGET_AVX512 inline V sigma0(V w) {
+    return Xor3(_mm512_ror_epi32(w, 7), _mm512_ror_epi32(w, 18), ShR(w, 3));
+}
+SHA256_TARGET_AVX512 inline V sigma1(V w) {
+    return Xor3(_mm512_ror_epi32(w, 17), _mm512_ror_epi32(w, 19), ShR(w, 10));
+}
+
+// Byte swap without AVX512BW: bytes 1,3 come from ror 8, bytes 0,2 from rol 8.
+SHA256_TARGET_AVX512 inline V Bswap(V x) {
+    return _mm512_ternarylogic_epi32(K(0xff00ff00), _mm512_ror_epi32(x, 8), _mm512_rol_epi32(x, 8), 0xca);
+}
+
+SHA256_TARGET_AVX512 inline V LaneOffsets() {
+    return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+}
+SHA256_TARGET_AVX512 inline V Load(const uint32_t* p) { return _mm512_loadu_si512(p); }
+SHA256_TARGET_AVX512 inline void Store(uint32_t* p, V v) { _mm512_storeu_si512(p, v); }
+
+SHA256_TARGET_AVX512 inline uint32_t TopWordMask(V h7, uint32_t targetTop) {
+    if (targetTop == 0) return _mm512_cmpeq_epu32_mask(h7, K(0));
+    return _mm512_cmple_epu32_mask(Bswap(h7), K(targetTop));
+}
+
+#include "sha256_lanes.inc"
+#undef SHA256_LANE_TARGET
+
+} // namespace sha256_avx512
+#pragma GCC diagnostic pop
+
+inline uint32_t scanHeaderSse41(const HeaderJob& job, uint32_t nonceBase) {
+    return sha256_sse41::ScanHeader(job, nonceBase);
+}
+
+inline uint32_t scanHeaderAvx2(const HeaderJob& job, uint32_t nonceBase) {
+    return sha256_avx2::ScanHeader(job, nonceBase);
+}
+
+inline uint32_t scanHeaderAvx512(const HeaderJob& job, uint32_t nonceBase) {
+    return sha256_avx512::ScanHeader(job, nonceBase);
+}
+
+inline void midstatesSse41(const uint32_t* w0, const uint32_t block[16], uint32_t* out) {
+    sha256_sse41::Midstates(w0, block, out);
+}
+
+inline void midstatesAvx2(const uint32_t* w0, const uint32_t block[16], uint32_t* out) {
+    sha256_avx2::Midstates(w0, block, out);
+}
+
+inline void midstatesAvx512(const uint32_t* w0, const uint32_t block[16], uint32_t* out) {
+    sha256_avx512::Midstates(w0, block, out);
+}
+
+inline void hashPairsSse41(const uint8_t* pairs, uint8_t* out) {
+    sha256_sse41::HashPairs(pairs, out);
+}
+
+inline void hashPairsAvx2(const uint8_t* pairs, uint8_t* out) {
+    sha256_avx2::HashPairs(pairs, out);
+}
+
+inline void hashPairsAvx512(const uint8_t* pairs, uint8_t* out) {
+    sha256_avx512::HashPairs(pairs, out);
+}
+
+#endif // SHA256_HAVE_X86
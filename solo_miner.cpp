@@ -3,7 +3,7 @@
 // For mainnet: ensure bitcoind runs on port 8332, server=1 in bitcoin.conf
 // and wallet loaded ready for coinbase (e.g. add address)
 // WARNING: CPU solo mining on mainnet is practically impossible due to high difficulty
-// Compile: g++ -std=c++11 -O2 solo_miner.cpp -lcurl -lcrypto -o solo_miner
+// Compile: g++ -std=c++11 -O2 -pthread solo_miner.cpp -lcurl -lcrypto -o solo_miner
 
 #include <iostream>
 #include <string>
@@ -13,13 +13,22 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <ctime>
 #include <random>
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <map>
+#include <memory>
 #include <curl/curl.h>
-#include <openssl/evp.h>  // Use instead of sha.h for OpenSSL 3.0+
 #include "json.hpp"
+#include "sha256_dispatch.hpp"
+#include "block_header.hpp"
+#include "work_queue.hpp"
+#include "cpu_topology.hpp"
+#include "autotune.hpp"
+#include "merkle.hpp"
 
 using json = nlohmann::json;
 using namespace std;
@@ -40,33 +49,18 @@ const string FLASK_URL = "http://localhost:5000/update";
 // Mutex for thread-safe cout
 std::mutex cout_mutex;
 
-// ========== Random Generator ==========
-std::mt19937 rng(std::random_device{}());
-
-// ========== Random Nonce in Middle 50% ==========
-uint32_t randomNonceInHalf(uint64_t start, uint64_t end) {
-    uint64_t range_size = end - start + 1;
-    if (range_size == 0) return 0;
-    uint64_t quarter = range_size / 4;
-    uint64_t half_s = start + quarter;
-    uint64_t half_e = start + 3 * quarter;
-    if (half_e < half_s) half_e = half_s;
-    std::uniform_int_distribution<uint64_t> dist(half_s, half_e);
-    return static_cast<uint32_t>(dist(rng));
-}
-
-// ========== Double SHA256 (using EVP) ==========
-vector<uint8_t> doubleSHA256(const vector<uint8_t>& data) {
-    uint8_t hash1[32], hash2[32];
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
-    EVP_DigestUpdate(ctx, data.data(), data.size());
-    EVP_DigestFinal_ex(ctx, hash1, nullptr);
-    EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
-    EVP_DigestUpdate(ctx, hash1, 32);
-    EVP_DigestFinal_ex(ctx, hash2, nullptr);
-    EVP_MD_CTX_free(ctx);
-    return vector<uint8_t>(hash2, hash2 + 32); // raw hash bytes
+// ========== Double SHA256 (kernel picked at startup by selectSha256Kernel) ==========
+Sha256Kernel sha256Kernel = {"portable", sha256OpenSSL, sha256Transform};
+
+Hash256 doubleSHA256(const uint8_t* data, size_t len) {
+    Hash256 hash1, hash2;
+    sha256Kernel.digest(data, len, hash1.data());
+    sha256Kernel.digest(hash1.data(), 32, hash2.data());
+    return hash2; // raw hash bytes
+}
+
+Hash256 doubleSHA256(const vector<uint8_t>& data) {
+    return doubleSHA256(data.data(), data.size());
 }
 
 // ========== Base58 Alphabet ==========
@@ -111,7 +105,6 @@ vector<uint8_t> decodeBase58Check(const string& addr) {
     vector<uint8_t> checksum(decoded.end() - 4, decoded.end());
     auto hash = doubleSHA256(payload);
 
-    if (hash.size() < 4) return {};
     if (hash[0] != checksum[0] || hash[1] != checksum[1] || hash[2] != checksum[2] || hash[3] != checksum[3]) return {};
 
     // Remove version byte
@@ -129,19 +122,15 @@ vector<uint8_t> hexToBytes(const string& hex) {
     return out;
 }
 
-string bytesToHex(const vector<uint8_t>& bytes) {
+string bytesToHex(const uint8_t* bytes, size_t len) {
     stringstream ss;
     ss << hex << setfill('0');
-    for (uint8_t b : bytes) ss << setw(2) << static_cast<int>(b);
+    for (size_t i = 0; i < len; ++i) ss << setw(2) << static_cast<int>(bytes[i]);
     return ss.str();
 }
 
-// ========== Write LE32 (fixed position) ==========
-void writeLE32(vector<uint8_t>& out, size_t pos, uint32_t val) {
-    out[pos] = val & 0xff;
-    out[pos+1] = (val >> 8) & 0xff;
-    out[pos+2] = (val >> 16) & 0xff;
-    out[pos+3] = (val >> 24) & 0xff;
+string bytesToHex(const vector<uint8_t>& bytes) {
+    return bytesToHex(bytes.data(), bytes.size());
 }
 
 // ========== Append LE32 ==========
@@ -198,7 +187,7 @@ string buildCoinbaseHex(uint32_t height, int64_t value, const string& addr) {
     tx.insert(tx.end(), 32, 0x00);
     // Index
     appendLE32(tx, 0xFFFFFFFF);
-    // ScriptSig: height LE4 + arb
+    // ScriptSig: height LE4 + arb (splitCoinbase appends the extranonce)
     vector<uint8_t> scriptSig;
     appendLE32(scriptSig, height);
     string arb = "/solo_miner_cpp/";
@@ -229,6 +218,143 @@ string buildCoinbaseHex(uint32_t height, int64_t value, const string& addr) {
     return bytesToHex(tx);
 }
 
+// ========== Coinbase Extranonce ==========
+// Bytes appended to the coinbase scriptSig and rolled once a header's 32-bit
+// nonce space is used up (little-endian counter)
+const size_t EXTRANONCE_SIZE = 8;
+const size_t MAX_SCRIPTSIG_SIZE = 100;
+
+// A coinbase split around its extranonce slot, which sits at the end of the
+// scriptSig. head/tail form the txid (non-witness) serialization; a segwit
+// coinbase keeps its witness aside and gets it back in the block.
+struct CoinbaseTx {
+    vector<uint8_t> head;     // version .. scriptSig (its length counts the extranonce)
+    vector<uint8_t> tail;     // sequence, outputs, locktime
+    vector<uint8_t> witness;  // witness section, empty for a legacy coinbase
+    // SHA-256 state after head's whole 64-byte blocks (cacheHeadMidstate)
+    uint32_t headMidstate[8] = {};
+    size_t headHashed = 0;
+
+    vector<uint8_t> txidBytes(uint64_t extranonce) const {
+        vector<uint8_t> tx(head);
+        appendSuffix(tx, extranonce);
+        return tx;
+    }
+
+    // Serialization for the block: marker, flag and witness go back in
+    vector<uint8_t> blockBytes(uint64_t extranonce) const {
+        vector<uint8_t> tx = txidBytes(extranonce);
+        if (witness.empty()) return tx;
+        tx.insert(tx.begin() + 4, {0x00, 0x01});
+        tx.insert(tx.end() - 4, witness.begin(), witness.end());
+        return tx;
+    }
+
+    // The head never changes, so only its last partial block, the extranonce
+    // and the tail are hashed per extranonce
+    void cacheHeadMidstate() {
+        headHashed = head.size() / 64 * 64;
+        memcpy(headMidstate, SHA256_IV, sizeof(headMidstate));
+        if (headHashed) sha256Kernel.transform(headMidstate, head.data(), headHashed / 64);
+    }
+
+    Hash256 txid(uint64_t extranonce) const {
+        vector<uint8_t> rest(head.begin() + headHashed, head.end());
+        appendSuffix(rest, extranonce);
+        Hash256 hash1, hash2;
+        sha256DigestFrom(sha256Kernel.transform, headMidstate, headHashed, rest.data(), rest.size(), hash1.data());
+        sha256Kernel.digest(hash1.data(), 32, hash2.data());
+        return hash2;
+    }
+
+private:
+    void appendSuffix(vector<uint8_t>& tx, uint64_t extranonce) const {
+        for (size_t i = 0; i < EXTRANONCE_SIZE; ++i) tx.push_back(static_cast<uint8_t>(extranonce >> (8 * i)));
+        tx.insert(tx.end(), tail.begin(), tail.end());
+    }
+};
+
+bool readVarInt(const vector<uint8_t>& b, size_t& i, uint64_t& n) {
+    if (i >= b.size()) return false;
+    uint8_t tag = b[i++];
+    size_t len = tag == 0xff ? 8 : tag == 0xfe ? 4 : tag == 0xfd ? 2 : 0;
+    if (len == 0) {
+        n = tag;
+        return true;
+    }
+    if (i + len > b.size()) return false;
+    n = 0;
+    for (size_t k = 0; k < len; ++k) n |= static_cast<uint64_t>(b[i + k]) << (8 * k);
+    i += len;
+    return true;
+}
+
+// Split a serialized coinbase (legacy or segwit) and give its scriptSig an
+// extranonce slot. False if it does not parse or the scriptSig has no room.
+bool splitCoinbase(const vector<uint8_t>& tx, CoinbaseTx& out) {
+    bool segwit = tx.size() > 6 && tx[4] == 0x00 && tx[5] == 0x01;
+    size_t i = segwit ? 6 : 4;
+    uint64_t inputs, scriptLen;
+    if (tx.size() < i || !readVarInt(tx, i, inputs) || inputs != 1) return false;
+    i += 36;  // prevout
+    size_t lenPos = i;
+    if (!readVarInt(tx, i, scriptLen) || scriptLen + EXTRANONCE_SIZE > MAX_SCRIPTSIG_SIZE) return false;
+    size_t scriptEnd = i + scriptLen;
+    i = scriptEnd + 4;  // sequence
+    uint64_t outputs, pkLen;
+    if (i > tx.size() || !readVarInt(tx, i, outputs)) return false;
+    for (uint64_t k = 0; k < outputs; ++k) {
+        i += 8;  // value
+        if (!readVarInt(tx, i, pkLen)) return false;
+        i += pkLen;
+    }
+    if (i + 4 > tx.size()) return false;
+
+    out.head.assign(tx.begin(), tx.begin() + 4);
+    out.head.insert(out.head.end(), tx.begin() + (segwit ? 6 : 4), tx.begin() + lenPos);
+    auto lenBytes = hexToBytes(encodeVarInt(scriptLen + EXTRANONCE_SIZE));
+    out.head.insert(out.head.end(), lenBytes.begin(), lenBytes.end());
+    out.head.insert(out.head.end(), tx.begin() + (scriptEnd - scriptLen), tx.begin() + scriptEnd);
+    out.tail.assign(tx.begin() + scriptEnd, tx.begin() + i);
+    out.tail.insert(out.tail.end(), tx.end() - 4, tx.end());
+    out.witness.clear();
+    if (segwit) out.witness.assign(tx.begin() + i, tx.end() - 4);
+    else if (i + 4 != tx.size()) return false;
+    out.cacheHeadMidstate();
+    return true;
+}
+
+// txid of a serialized transaction: the hash of its non-witness form, so a
+// segwit transaction drops marker, flag and witness first. False if it does
+// not parse.
+bool rawTxid(const vector<uint8_t>& tx, Hash256& out) {
+    bool segwit = tx.size() > 6 && tx[4] == 0x00 && tx[5] == 0x01;
+    if (!segwit) {
+        out = doubleSHA256(tx);
+        return true;
+    }
+    size_t i = 6;
+    uint64_t count, len;
+    if (!readVarInt(tx, i, count)) return false;
+    for (uint64_t k = 0; k < count; ++k) {
+        i += 36;  // prevout
+        if (!readVarInt(tx, i, len)) return false;
+        i += len + 4;  // scriptSig, sequence
+    }
+    if (!readVarInt(tx, i, count)) return false;
+    for (uint64_t k = 0; k < count; ++k) {
+        i += 8;  // value
+        if (!readVarInt(tx, i, len)) return false;
+        i += len;
+    }
+    if (i + 4 > tx.size()) return false;
+    vector<uint8_t> stripped(tx.begin(), tx.begin() + 4);
+    stripped.insert(stripped.end(), tx.begin() + 6, tx.begin() + i);
+    stripped.insert(stripped.end(), tx.end() - 4, tx.end());
+    out = doubleSHA256(stripped);
+    return true;
+}
+
 // ========== Get BTC Price from Binance ==========
 static size_t WriteCallbackPrice(void* contents, size_t size, size_t nmemb, string* out) {
     out->append((char*)contents, size * nmemb);
@@ -335,44 +461,41 @@ string bitcoinRPC(const string& method, const json& params = json::array()) {
 }
 
 // ========== Merkle Root ==========
-vector<uint8_t> computeMerkleRoot(const vector<string>& txHexes) {
-    if (txHexes.empty()) return vector<uint8_t>(32, 0);
-    vector<vector<uint8_t>> hashes;
-    for (const auto& txHex : txHexes) {
-        auto txBytes = hexToBytes(txHex);
-        auto hash = doubleSHA256(txBytes);
-        reverse(hash.begin(), hash.end());
-        hashes.push_back(hash);
-    }
-    while (hashes.size() > 1) {
-        if (hashes.size() % 2 == 1) hashes.push_back(hashes.back());
-        vector<vector<uint8_t>> next;
-        for (size_t i = 0; i < hashes.size(); i += 2) {
-            auto concat = hashes[i];
-            concat.insert(concat.end(), hashes[i+1].begin(), hashes[i+1].end());
-            auto hash = doubleSHA256(concat);
-            reverse(hash.begin(), hash.end());
-            next.push_back(hash);
-        }
-        hashes = move(next);
+// Internal byte order throughout (txids as hashed, root as stored in the header).
+// Only the coinbase changes while mining a template, so the tree is reduced
+// once to the coinbase's branch (MerkleTree::coinbaseBranch): the sibling
+// hash at every level on the path from leaf 0 to the root. A new coinbase
+// then costs its own txid (from the cached head midstate, see CoinbaseTx)
+// plus log2(n) hashes.
+MerkleEngine merkleEngine;  // kernel and threads picked in main()
+
+Hash256 merkleRootFromBranch(const Hash256& coinbaseTxid, const vector<Hash256>& branch) {
+    Hash256 h = coinbaseTxid;
+    uint8_t pair[64];
+    for (const auto& sibling : branch) {
+        memcpy(pair, h.data(), 32);
+        memcpy(pair + 32, sibling.data(), 32);
+        h = doubleSHA256(pair, sizeof(pair));
     }
-    return hashes[0];
+    return h;
 }
 
 // ====== Improved Bits -> Target (big-endian) ======
-vector<uint8_t> bitsToTarget(const string& bitsHex) {
+Hash256 bitsToTarget(const string& bitsHex) {
     // parse compact bits as a 32-bit hex value (e.g. "1b0404cb")
     uint32_t bits = 0;
     try {
         bits = static_cast<uint32_t>(stoul(bitsHex, nullptr, 16));
     } catch (...) {
-        return vector<uint8_t>(32, 0xff);
+        Hash256 easiest;
+        easiest.fill(0xff);
+        return easiest;
     }
 
     uint8_t exp = (bits >> 24) & 0xff;
     uint32_t mantissa = bits & 0x007fffff; // compact format uses 23 bits for mantissa (mask used in Bitcoin Core)
 
-    vector<uint8_t> target(32, 0);
+    Hash256 target = {};
 
     if (exp <= 3) {
         // shift mantissa right when exponent <= 3
@@ -383,7 +506,7 @@ vector<uint8_t> bitsToTarget(const string& bitsHex) {
     } else {
         // place mantissa bytes starting at index = 32 - exp
         int idx = 32 - exp;
-        if (idx < 0) return vector<uint8_t>(32, 0); // exponent too large -> invalid
+        if (idx < 0) return Hash256(); // exponent too large -> invalid
         if (idx <= 29) {
             target[idx]     = (mantissa >> 16) & 0xff;
             target[idx + 1] = (mantissa >> 8)  & 0xff;
@@ -401,7 +524,7 @@ vector<uint8_t> bitsToTarget(const string& bitsHex) {
     return target;
 }
 
-bool hashBelowTarget(const vector<uint8_t>& hash_be, const vector<uint8_t>& target_be) {
+bool hashBelowTarget(const Hash256& hash_be, const Hash256& target_be) {
     return memcmp(hash_be.data(), target_be.data(), 32) < 0;
 }
 
@@ -478,15 +601,34 @@ void printHackerBanner(const string& version) {
     cout << "\r" << RESET << flush;
 }
 
-// ========== Main ==========
-int main() {
-    // Hacker Banner with animation
-    printHackerBanner("v0.1");
-
-    // Get initial BTC Price
-    string btcPrice = getBTCPrice();
-    cout << GREEN << BOLD << ">>> BTC/USDT Price: $" << btcPrice << RESET << "\n\n";
+// ========== Block Template -> Mining Job ==========
+// Everything one getblocktemplate result turns into. Read-only while the
+// miner threads run.
+struct MiningJob {
+    uint32_t height = 0;
+    string prevHash;
+    CoinbaseTx coinbase;
+    vector<string> txHexes;        // everything after the coinbase
+    vector<Hash256> txids;         // their txids (internal order), the merkle leaves
+    MerkleTree merkle;             // leaf 0 is a placeholder for the coinbase
+    vector<Hash256> merkleBranch;  // coinbase path (MerkleTree::coinbaseBranch)
+    BlockHeader header;            // with extranonce 0, ntime = curtime
+    Hash256 targetBE;
+    uint32_t minTime = 0;          // earliest valid ntime
+
+    // Header for one extranonce: only the merkle root differs
+    BlockHeader headerFor(uint64_t extranonce) const {
+        BlockHeader h = header;
+        h.setMerkleRoot(merkleRootFromBranch(coinbase.txid(extranonce), merkleBranch).data());
+        return h;
+    }
+};
 
+// `templateTxids`: take the leaves from the template's txid fields rather
+// than hashing every transaction. `previous`: the last template, whose merkle
+// tree is reused if this one builds on the same tip.
+bool fetchMiningJob(const string& myAddr, MiningJob& job, bool templateTxids = true,
+                    const MiningJob* previous = nullptr) {
     // 1. Get block template (assume wallet loaded)
     json template_req = {
         {"mode", "template"},
@@ -497,43 +639,27 @@ int main() {
     if (resp.empty()) {
         cerr << RED << ">>> Empty gbt response. Try testing with curl:\n";
         cerr << "curl --user pukumpee:123pp --data '{\"jsonrpc\":\"1.0\",\"id\":\"test\",\"method\":\"getblocktemplate\",\"params\":[]}' http://127.0.0.1:8332/\n" << RESET;
-        return 1;
+        return false;
     }
 
     json j;
     try { j = json::parse(resp); }
     catch (...) {
         cerr << RED << ">>> Parse gbt failed." << RESET << "\n";
-        return 1;
+        return false;
     }
     if (j.contains("error") && !j["error"].is_null()) {
         cerr << RED << ">>> GBT Error: " << j["error"] << RESET << "\n";
-        return 1;
+        return false;
     }
     json gbt = j["result"];
 
-    uint32_t block_height = gbt["height"].get<uint32_t>();
+    job.height = gbt["height"].get<uint32_t>();
+    job.prevHash = gbt["previousblockhash"].get<string>();
 
-    cout << BLUE << ">>> Mining block " << block_height << " on " << gbt["previousblockhash"].get<string>() << RESET << "\n";
+    cout << BLUE << ">>> Mining block " << job.height << " on " << job.prevHash << RESET << "\n";
 
-    // 2. Get legacy address (from loaded wallet)
-    string addrResp = bitcoinRPC("getnewaddress", json::array({"", "legacy"}));
-    string myAddr;
-    if (!addrResp.empty()) {
-        try {
-            json addrJ = json::parse(addrResp);
-            if (addrJ.contains("result") && addrJ["result"].is_string()) {
-                myAddr = addrJ["result"].get<string>();
-                cout << GREEN << ">>> Legacy Address: " << myAddr << RESET << "\n";
-            }
-        } catch (...) {}
-    }
-    if (myAddr.empty()) {
-        cerr << RED << ">>> Failed to get legacy address. Run: bitcoin-cli getnewaddress '' 'legacy'" << RESET << "\n";
-        return 1;
-    }
-
-    // 3. Coinbase (prefer provided, fallback manual)
+    // 2. Coinbase (prefer provided, fallback manual)
     string coinbaseHex;
     if (gbt.contains("coinbasetxn") && !gbt["coinbasetxn"].is_null()) {
         coinbaseHex = gbt["coinbasetxn"]["data"].get<string>();
@@ -541,167 +667,601 @@ int main() {
     } else {
         // Fallback manual
         int64_t value = gbt["coinbasevalue"].get<int64_t>();
-        coinbaseHex = buildCoinbaseHex(block_height, value, myAddr);
+        coinbaseHex = buildCoinbaseHex(job.height, value, myAddr);
         if (coinbaseHex.empty()) {
             cerr << RED << ">>> Manual coinbase failed. Upgrade Bitcoin Core." << RESET << "\n";
-            return 1;
+            return false;
         }
-        cout << GREEN << ">>> Manual coinbase (height: " << block_height << ", value: " << value << " sat)" << RESET << "\n";
+        cout << GREEN << ">>> Manual coinbase (height: " << job.height << ", value: " << value << " sat)" << RESET << "\n";
     }
 
-    // 4. Tx list
-    vector<string> txHexes {coinbaseHex};
+    if (!splitCoinbase(hexToBytes(coinbaseHex), job.coinbase)) {
+        cerr << RED << ">>> Coinbase has no room for a " << EXTRANONCE_SIZE << "-byte extranonce in its scriptSig." << RESET << "\n";
+        return false;
+    }
+
+    // 3. Tx list. bitcoind already gives every txid (RPC byte order), so a
+    // transaction is only hashed here when its txid is missing or unusable.
+    job.txHexes.clear();
+    job.txids.clear();
     if (gbt.contains("transactions")) {
         for (auto& tx : gbt["transactions"]) {
-            txHexes.push_back(tx["data"].get<string>());
+            job.txHexes.push_back(tx["data"].get<string>());
+            Hash256 txid;
+            bool given = templateTxids && tx.contains("txid") && tx["txid"].is_string() &&
+                         tx["txid"].get<string>().size() == 64;
+            if (given) {
+                auto bytes = hexToBytes(tx["txid"].get<string>());
+                reverse_copy(bytes.begin(), bytes.end(), txid.begin());
+            } else if (!rawTxid(hexToBytes(job.txHexes.back()), txid)) {
+                cerr << RED << ">>> Template transaction " << job.txHexes.size() << " does not parse." << RESET << "\n";
+                return false;
+            }
+            job.txids.push_back(txid);
         }
     }
 
-    // 5. Merkle root (LE)
-    auto merkleRootLE = computeMerkleRoot(txHexes);
-    cout << CYAN << ">>> Merkle root: " << bytesToHex(merkleRootLE) << RESET << "\n";
+    // 4. Merkle tree and coinbase branch, root (LE) for extranonce 0. A
+    // refresh on the same tip only rehashes the subtrees that changed.
+    vector<Hash256> leaves(1);
+    leaves.insert(leaves.end(), job.txids.begin(), job.txids.end());
+    if (previous && previous->prevHash == job.prevHash) {
+        size_t rehashed = 0;
+        job.merkle = merkleEngine.update(previous->merkle, move(leaves), &rehashed);
+        cout << CYAN << ">>> Template refresh: " << job.txids.size() << " txs, " << rehashed << " of " << job.merkle.innerNodes() << " merkle nodes rehashed" << RESET << "\n";
+    } else {
+        job.merkle = merkleEngine.build(move(leaves));
+    }
+    job.merkleBranch = job.merkle.coinbaseBranch();
+    Hash256 merkleRootLE = merkleRootFromBranch(job.coinbase.txid(0), job.merkleBranch);
+    Hash256 merkleRootBE = merkleRootLE;
+    reverse(merkleRootBE.begin(), merkleRootBE.end());
+    cout << CYAN << ">>> Merkle root: " << bytesToHex(merkleRootBE.data(), 32) << RESET << "\n";
 
-    // 6. Block header
-    vector<uint8_t> header(80, 0);
-    writeLE32(header, 0, gbt["version"].get<uint32_t>());
-    auto prevHashBytes = hexToBytes(gbt["previousblockhash"].get<string>());
+    // 5. Block header
+    string bitsStr = gbt["bits"].get<string>();
+    job.header = BlockHeader();
+    job.header.setVersion(gbt["version"].get<uint32_t>());
+    auto prevHashBytes = hexToBytes(job.prevHash);
     reverse(prevHashBytes.begin(), prevHashBytes.end());
-    copy(prevHashBytes.begin(), prevHashBytes.end(), header.begin() + 4);
-    copy(merkleRootLE.begin(), merkleRootLE.end(), header.begin() + 36);
-    writeLE32(header, 68, gbt["curtime"].get<uint32_t>());
-    auto bitsBytes = hexToBytes(gbt["bits"].get<string>());
-    copy(bitsBytes.begin(), bitsBytes.end(), header.begin() + 72);
+    job.header.setPrevHash(prevHashBytes.data());
+    job.header.setMerkleRoot(merkleRootLE.data());
+    job.header.setTime(gbt["curtime"].get<uint32_t>());
+    job.minTime = gbt.contains("mintime") ? gbt["mintime"].get<uint32_t>() : job.header.time();
+    job.header.setBits(static_cast<uint32_t>(stoul(bitsStr, nullptr, 16)));
+
+    // 6. Target (BE)
+    job.targetBE = bitsToTarget(bitsStr);
+    cout << YELLOW << ">>> Target: " << bytesToHex(job.targetBE.data(), 32) << RESET << "\n";
+    return true;
+}
 
-    // 7. Target (BE)
-    string bitsStr = gbt["bits"].get<string>();
-    auto targetBE = bitsToTarget(bitsStr);
-    cout << YELLOW << ">>> Target: " << bytesToHex(targetBE) << RESET << "\n";
+// Cheap staleness check: the template is dead once the tip moves
+string getBestBlockHash() {
+    string resp = bitcoinRPC("getbestblockhash");
+    if (resp.empty()) return "";
+    try {
+        json j = json::parse(resp);
+        if (j.contains("result") && j["result"].is_string()) return j["result"].get<string>();
+    } catch (...) {}
+    return "";
+}
+
+// ========== Mining Engine ==========
+const int TEMPLATE_POLL_SECONDS = 5;
+const int TEMPLATE_REFRESH_SECONDS = 30;  // same tip: pick up new mempool transactions
+const int FLASK_SEND_SECONDS = 5;
+const int PROGRESS_BAR_SECONDS = 10;
+// Batches a thread hashes between publishing its count and nonce
+const uint32_t MINER_FLUSH_BATCHES = 4096;
+
+// Nonces per work unit: small enough that threads finish a header's nonce
+// space together, large enough that queue traffic stays rare. Picked from
+// MINER_TUNE_CHUNKS by the auto-tuner at startup.
+const vector<uint64_t> MINER_TUNE_CHUNKS = {1 << 14, 1 << 16, 1 << 18};
+// Work units the producer keeps queued ahead of the hashing threads
+const size_t WORK_QUEUE_UNITS = 256;
+// Nodes reject blocks more than 2 h ahead of their clock; ntime rolling
+// stays within half of that to allow for clock skew between us and them
+const uint32_t MAX_FUTURE_BLOCK_TIME = 2 * 60 * 60;
+const uint32_t NTIME_MAX_AHEAD = MAX_FUTURE_BLOCK_TIME / 2;
+// BIP320 general-purpose version bits, rolled on top of the template version
+const uint32_t VERSION_ROLL_MASK = 0x1fffe000;
+const uint32_t VERSION_ROLLS = 1 << 16;
+
+inline uint32_t rolledVersion(uint32_t base, uint32_t index) {
+    return base ^ ((index << 13) & VERSION_ROLL_MASK);
+}
 
-    // Initial send to Flask
-    sendStatsToFlask(0, 0.0, 0, btcPrice, block_height, 0, 0xFFFFFFFFULL);
+// First-block midstates of one header for all rolled versions, computed
+// `lanes` versions per kernel call as the producer gets to them
+struct VersionMidstates {
+    MidstateBatcher batcher;
+    uint32_t block[16];
+    uint32_t base = 0;
+    uint32_t first = VERSION_ROLLS;  // first version index of the batch in `states`
+    uint32_t states[8 * 16];
+
+    void reset(const BlockHeader& header) {
+        for (int i = 0; i < 16; ++i) block[i] = readBE32(header.data() + 4 * i);
+        base = header.version();
+        first = VERSION_ROLLS;
+    }
 
-    // 8. Setup nonce range
-    uint64_t search_start = 0;
-    uint64_t search_end = 0xFFFFFFFFULL;
-    auto last_reset = chrono::steady_clock::now();
-    uint64_t tried = 0;
+    void get(uint32_t index, uint32_t midstate[8]) {
+        if (index < first || index >= first + batcher.lanes) {
+            first = index / batcher.lanes * batcher.lanes;
+            uint32_t w0[16];
+            for (int lane = 0; lane < batcher.lanes; ++lane) w0[lane] = bswap32(rolledVersion(base, first + lane));
+            batcher.midstates(w0, block, states);
+        }
+        for (int i = 0; i < 8; ++i) midstate[i] = states[i * batcher.lanes + index - first];
+    }
+};
+
+// One slice of one header's nonce space, ready to hash: the producer has
+// already built the header and its midstate and precompute.
+struct WorkUnit {
+    uint64_t templateId = 0;
+    uint64_t extranonce = 0;
+    uint32_t ntime = 0;
+    uint32_t version = 0;
+    HeaderJob job;
+    Hash256 targetBE;
+    uint64_t nonceFirst = 0;
+    uint64_t nonceEnd = 0;
+};
+
+// Shared by the producer, the hashing threads and main(). Units of templates
+// with an id below `validFrom` are stale and dropped unhashed; main() raises
+// it when the tip moves and each new template supersedes the ones before.
+// `halt` stales everything once a block is found.
+struct MinerPipeline {
+    explicit MinerPipeline(size_t units) : queue(units) {}
+
+    BoundedQueue<WorkUnit> queue;
+    std::atomic<uint64_t> validFrom{0};
+    std::atomic<bool> refresh{false};   // main() -> producer: fetch a template now
+    std::atomic<bool> failed{false};    // producer could not get a template
+    std::atomic<bool> halt{false};
+    std::atomic<bool> shutdown{false};
+    std::atomic<int> active{0};         // threads with id >= active stay parked
+    std::atomic<uint64_t> tried{0};
+    std::atomic<uint64_t> templateTried{0};  // `tried` when the current template came in
+    std::atomic<uint32_t> lastNonce{0};
+    std::atomic<uint64_t> extranonce{0};     // latest one queued
+    std::atomic<bool> badTxids{false};       // a template's txids failed verification
+
+    // A hit is recorded under foundMutex; `found` is also polled by main()
+    std::mutex foundMutex;
+    std::atomic<bool> found{false};
+    uint64_t foundTemplate = 0;
+    uint64_t foundExtranonce = 0;
+    uint32_t foundTime = 0;
+    uint32_t foundVersion = 0;
+    uint32_t foundNonce = 0;
+    Hash256 foundHash;
+
+    bool live(uint64_t id) const {
+        return id >= validFrom.load(std::memory_order_relaxed) && !halt.load(std::memory_order_relaxed);
+    }
 
-    // Hashrate tracking
-    auto last_time = chrono::steady_clock::now();
-    uint64_t last_tried = 0;
-    int animation_frame = 0;
+    // Register `job` as the newest template and return its id; units of older
+    // ones are dropped from here on. Stale templates are released here, but
+    // the previous one only on the next publish: a block found on it just
+    // before this call can still be looked up and submitted.
+    uint64_t publish(const shared_ptr<const MiningJob>& job) {
+        std::lock_guard<std::mutex> lock(templateMutex);
+        uint64_t id = ++currentId;
+        templates[id] = job;
+        uint64_t keepFrom = max<uint64_t>(validFrom.load(), id - 1);
+        templates.erase(templates.begin(), templates.lower_bound(keepFrom));
+        if (validFrom.load() < id) validFrom = id;
+        templateTried = tried.load();
+        return id;
+    }
 
-    string spinner = "⠋⠙⠹⠸⠼⠴⠦⠧⠇⠏";
+    shared_ptr<const MiningJob> current() {
+        std::lock_guard<std::mutex> lock(templateMutex);
+        auto it = templates.find(currentId);
+        return it == templates.end() ? nullptr : it->second;
+    }
 
-    cout << MAGENTA << BOLD << ">>> BitcoinMiner initiated. Entering the matrix..." << RESET << "\n";
-    cout << BLUE << ">>> Searching for nonce in range [0x" << hex << setfill('0') << setw(8) << search_start << " - 0x" << setw(8) << search_end << "]" << dec << RESET << "\n\n";
+    shared_ptr<const MiningJob> lookup(uint64_t id) {
+        std::lock_guard<std::mutex> lock(templateMutex);
+        auto it = templates.find(id);
+        return it == templates.end() ? nullptr : it->second;
+    }
 
-    // Mining loop
-    while (true) {
-        auto now = chrono::steady_clock::now();
-        auto elapsed_min = chrono::duration_cast<chrono::minutes>(now - last_reset).count();
-        if (elapsed_min >= 10) {
-            uint64_t range_size = search_end - search_start + 1;
-            uint64_t quarter = range_size / 4;
-            uint64_t new_start = search_start + quarter;
-            uint64_t new_end = search_start + 3 * quarter;
-            if (new_end < new_start) new_end = new_start;
-            search_start = new_start;
-            search_end = new_end;
+    // Everything published so far is stale
+    void invalidate() {
+        std::lock_guard<std::mutex> lock(templateMutex);
+        if (validFrom.load() <= currentId) validFrom = currentId + 1;
+    }
+
+private:
+    std::mutex templateMutex;
+    std::map<uint64_t, shared_ptr<const MiningJob>> templates;
+    uint64_t currentId = 0;
+};
+
+// MINER_VERIFY_TXIDS=1: rehash a template's transactions next to the
+// mining and drop the template if a txid it came with is wrong, since its
+// block would be rejected for a bad merkle root. Later templates are then
+// hashed in full.
+void verifyTemplateTxids(MinerPipeline& pipe, shared_ptr<const MiningJob> job, uint64_t templateId) {
+    for (size_t i = 0; i < job->txHexes.size() && !pipe.shutdown && pipe.live(templateId); ++i) {
+        Hash256 txid;
+        if (rawTxid(hexToBytes(job->txHexes[i]), txid) && txid == job->txids[i]) continue;
+        {
+            std::lock_guard<std::mutex> lock(cout_mutex);
+            cout << "\n" << RED << ">>> Template txid " << i + 1 << " does not match its data, hashing templates from now on" << RESET << "\n";
+        }
+        pipe.badTxids = true;
+        pipe.invalidate();
+        pipe.refresh = true;
+        return;
+    }
+}
+
+// Producer stage: fetches templates, builds each header and its midstate
+// once, and queues its nonce space as units of `unitSize` nonces. When a
+// header's nonce space is queued the next header is the cheapest fresh one:
+//   1. ntime to the clock, if it moved (midstate kept, tail precompute redone)
+//   2. the next BIP320 version (a midstate from the batched midstate kernel)
+//   3. ntime one second on with the versions from the start, up to
+//      NTIME_MAX_AHEAD past the clock
+//   4. the next extranonce: a new coinbase txid and root from the cached branch
+// Template RPCs and merkle work run here while the hashing threads drain the
+// queue. A refreshed template on the same tip reuses the last one's merkle
+// tree and carries on with its extranonce counter, so no header is repeated
+// even if the transactions did not change. The thread count follows the
+// cgroup quota, re-read for every template.
+void producerThread(MinerPipeline& pipe, string myAddr, MidstateBatcher batcher, uint64_t unitSize,
+                    size_t maxThreads, bool fixedThreads, bool verifyTxids) {
+    VersionMidstates versions;
+    versions.batcher = batcher;
+    thread verifier;
+    shared_ptr<const MiningJob> previous;
+    uint64_t previousId = 0;
+    uint64_t nextExtranonce = 0;
+    while (!pipe.shutdown && !pipe.halt) {
+        pipe.refresh = false;
+        auto fetched = make_shared<MiningJob>();
+        if (fetchMiningJob(myAddr, *fetched, !pipe.badTxids, previous.get())) {
+            if (!previous || previous->prevHash != fetched->prevHash) nextExtranonce = 0;
+            previous = fetched;
+            previousId = pipe.publish(previous);
+            if (verifyTxids && !pipe.badTxids) {
+                if (verifier.joinable()) verifier.join();
+                verifier = thread(verifyTemplateTxids, ref(pipe), previous, previousId);
+            }
+        } else if (!previous) {
+            pipe.failed = true;
+            break;
+        } else {
+            // Only fatal without any template: keep mining the last one while
+            // it is valid, and retry on the next refresh (or in a second if
+            // the tip moved and it went stale)
             {
                 std::lock_guard<std::mutex> lock(cout_mutex);
-                cout << YELLOW << ">>> Range reset: [0x" << hex << setfill('0') << setw(8) << search_start << " - 0x" << setw(8) << search_end << "]" << dec << RESET << "\n";
+                cout << "\n" << YELLOW << ">>> Template fetch failed, retrying" << (pipe.live(previousId) ? "; mining the last template meanwhile" : " in 1 s") << RESET << "\n";
+            }
+            if (!pipe.live(previousId)) {
+                this_thread::sleep_for(chrono::seconds(1));
+                continue;
             }
-            last_reset = now;
         }
+        shared_ptr<const MiningJob> job = previous;
 
-        uint32_t nonce = randomNonceInHalf(search_start, search_end);
-        writeLE32(header, 76, nonce);
-        auto hashBE = doubleSHA256(header);
-        tried++;
-        animation_frame++;
-
-        // Send to Flask every 5M hashes
-        if (tried % 5000000ULL == 0) {
-            auto delta_time = chrono::duration_cast<chrono::seconds>(now - last_time).count();
-            double hashrate = 0.0;
-            if (delta_time > 0) {
-                hashrate = static_cast<double>(tried - last_tried) / delta_time;
+        if (!fixedThreads) {
+            CgroupCpuLimit now = readCgroupCpuLimit();
+            int usable = usableCpus(maxThreads, now);
+            if (usable != pipe.active) {
+                std::lock_guard<std::mutex> lock(cout_mutex);
+                cout << CYAN << ">>> Container limit now " << cgroupLimitString(now) << ", miner threads: " << usable << RESET << "\n";
+                pipe.active = usable;
             }
-            string current_price = getBTCPrice();  // Refresh price occasionally
-            sendStatsToFlask(tried, hashrate, nonce, current_price, block_height, search_start, search_end);
         }
 
-        // Live spinner every 1M hashes
-        if (tried % 1000000ULL == 0) {
-            auto delta_time = chrono::duration_cast<chrono::seconds>(now - last_time).count();
-            double hashrate = 0.0;
-            if (delta_time > 0) {
-                hashrate = static_cast<double>(tried - last_tried) / delta_time;
-            }
-            {
-                std::lock_guard<std::mutex> lock(cout_mutex);
-                cout << "\r" << CYAN << "🔥 Mining " << spinner[animation_frame % spinner.length()] << " | Hashes: " << tried << " | Rate: " << fixed << setprecision(2) << hashrate << " H/s" << RESET << flush;
+        WorkUnit unit;
+        unit.templateId = previousId;
+        unit.targetBE = job->targetBE;
+        auto halted = [&] { return pipe.shutdown || pipe.refresh || !pipe.live(unit.templateId); };
+
+        for (uint64_t extranonce = nextExtranonce; !halted(); ++extranonce) {
+            nextExtranonce = extranonce + 1;
+            BlockHeader header = extranonce == 0 ? job->header : job->headerFor(extranonce);
+            unit.extranonce = extranonce;
+            unit.job = prepareHeaderJob(header.data(), job->targetBE.data());
+            versions.reset(header);
+            pipe.extranonce = extranonce;
+            uint32_t ntime = max(header.time(), job->minTime);
+            uint32_t versionIndex = 0;
+            while (!halted()) {
+                unit.ntime = ntime;
+                unit.version = rolledVersion(header.version(), versionIndex);
+                versions.get(versionIndex, unit.job.midstate);
+                setHeaderJobTime(unit.job, ntime);
+                for (uint64_t first = 0; first < 0x100000000ULL && !halted(); first += unitSize) {
+                    unit.nonceFirst = first;
+                    unit.nonceEnd = min<uint64_t>(first + unitSize, 0x100000000ULL);
+                    // Full queue: the hashing threads are busy, check back shortly
+                    while (!pipe.queue.tryPush(unit) && !halted()) {
+                        this_thread::sleep_for(chrono::milliseconds(1));
+                    }
+                }
+                // ntime never goes back and versions only repeat with a
+                // later ntime, so every header is new
+                uint32_t now = static_cast<uint32_t>(time(nullptr));
+                if (now > ntime) {
+                    ntime = now;
+                } else if (versionIndex + 1 < VERSION_ROLLS) {
+                    ++versionIndex;
+                } else if (ntime + 1 <= now + NTIME_MAX_AHEAD) {
+                    ++ntime;
+                    versionIndex = 0;
+                } else {
+                    break;
+                }
             }
-            last_tried = tried;
-            last_time = now;
         }
+    }
+    if (verifier.joinable()) verifier.join();
+}
 
-        // Progress bar every 10M
-        if (tried % 10000000ULL == 0) {
-            auto delta_time = chrono::duration_cast<chrono::seconds>(now - last_time).count();
-            double hashrate = 0.0;
-            if (delta_time > 0) {
-                hashrate = static_cast<double>(tried - last_tried) / delta_time;
+// Hashing thread `id`: pops units and sweeps them, dropping units whose
+// template went stale (also mid-unit). It runs pinned to `cpu` (-1:
+// unpinned) and never waits on RPC or template work, only on an empty queue.
+void minerThread(int id, int cpu, HeaderScanner scanner, MinerPipeline& pipe) {
+    if (cpu >= 0) pinCurrentThread(cpu);
+    HeaderHashState state;
+    WorkUnit unit;
+
+    uint64_t pending = 0;
+    while (!pipe.shutdown.load(std::memory_order_relaxed)) {
+        if (id >= pipe.active.load(std::memory_order_relaxed) || !pipe.queue.tryPop(unit)) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
+        }
+        state.job = unit.job;
+        // Units are whole multiples of 16 nonces, so no kernel batch straddles two
+        for (uint64_t nonce = unit.nonceFirst; nonce < unit.nonceEnd && pipe.live(unit.templateId);
+             nonce += scanner.lanes) {
+            uint32_t base = static_cast<uint32_t>(nonce);
+            uint32_t hitMask = scanner.scan(state.job, base);
+
+            // The kernel only checks the top hash word; confirm each candidate
+            // lane with the full hash before treating it as a block
+            if (hitMask && state.confirm(base, hitMask) && hashBelowTarget(state.hashBE, unit.targetBE)) {
+                std::lock_guard<std::mutex> lock(pipe.foundMutex);
+                if (!pipe.found && pipe.live(unit.templateId)) {
+                    pipe.found = true;
+                    pipe.foundTemplate = unit.templateId;
+                    pipe.foundExtranonce = unit.extranonce;
+                    pipe.foundTime = unit.ntime;
+                    pipe.foundVersion = unit.version;
+                    pipe.foundNonce = state.nonce;
+                    pipe.foundHash = state.hashBE;
+                    pipe.halt = true;
+                }
             }
-            {
-                std::lock_guard<std::mutex> lock(cout_mutex);
-                cout << "\n" << BOLD << ">>> " << RESET;
-                printProgressBar(tried, 0xFFFFFFFFULL, hashrate, animation_frame);
-                cout << " | Current nonce: 0x" << hex << setw(8) << setfill('0') << nonce << dec << RESET << "\n";
+
+            if (++pending == MINER_FLUSH_BATCHES) {
+                pipe.tried += pending * scanner.lanes;
+                if (id == 0) pipe.lastNonce = base;
+                pending = 0;
             }
-            last_tried = tried;
-            last_time = now;
         }
+    }
+    pipe.tried += pending * scanner.lanes;
+}
 
-        if (hashBelowTarget(hashBE, targetBE)) {
-            // Clear line and celebrate
-            {
-                std::lock_guard<std::mutex> lock(cout_mutex);
-                cout << "\n" << GREEN << BOLD;
-                celebrateBlock();
-                auto hashLE = hashBE;
-                reverse(hashLE.begin(), hashLE.end());
-                string hashStr = bytesToHex(hashLE);
-                cout << ">>> BLOCK FOUND! Nonce: 0x" << hex << setw(8) << setfill('0') << nonce << dec << " | Hash: " << hashStr << RESET << "\n";
+// ========== Main ==========
+int main(int argc, char** argv) {
+    // Hacker Banner with animation
+    printHackerBanner("v0.1");
+    // The producer thread and main() both make curl requests
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    // Pick hash kernels for this CPU (self-tested against OpenSSL)
+    sha256Kernel = selectSha256Kernel();
+    vector<HeaderScanner> scanners = passingHeaderScanners();
+    HeaderScanner scanner = scanners.front();
+    cout << CYAN << ">>> CPU features: " << cpuFeatureString(detectCpuFeatures()) << RESET << "\n";
+    MidstateBatcher midstates = selectMidstateBatcher();
+    cout << CYAN << ">>> SHA256 kernel: " << sha256Kernel.name << " | Version-rolling midstates: " << midstates.name << " (" << midstates.lanes << " lanes)" << RESET << "\n";
+
+    // Placement: one thread per physical core, SMT siblings only if they pay
+    CpuTopology topo = readCpuTopology();
+    HeaderJob benchJob = prepareHeaderJob(BlockHeader().data(), Hash256().data());
+    double smt = smtSpeedup(topo, [&] {
+        scanner.scan(benchJob, 0);
+        return static_cast<uint64_t>(scanner.lanes);
+    });
+    vector<int> cpus = placementOrder(topo, smt >= SMT_MIN_SPEEDUP);
+    cout << CYAN << ">>> CPU topology: " << topo.summary() << RESET << "\n";
+    if (smt > 0) {
+        cout << CYAN << ">>> SMT speedup x" << fixed << setprecision(2) << smt << (smt >= SMT_MIN_SPEEDUP ? ", using siblings" : ", one thread per core") << RESET << "\n";
+    }
+
+    // Threads: first argument, default one per placement CPU within the
+    // cgroup CPU quota (re-read for every template, so quota changes apply)
+    bool fixedThreads = argc > 1;
+    int numThreads = fixedThreads ? atoi(argv[1]) : static_cast<int>(cpus.size());
+    if (numThreads < 1) numThreads = 1;
+    CgroupCpuLimit cpuLimit = readCgroupCpuLimit();
+    if (!fixedThreads) numThreads = usableCpus(cpus.size(), cpuLimit);
+    cout << CYAN << ">>> Container limit: " << cgroupLimitString(cpuLimit) << RESET << "\n";
+
+    // Auto-tune header kernel, thread count and claim size on this host;
+    // cached per CPU model and microcode
+    vector<string> kernelNames;
+    for (const auto& s : scanners) kernelNames.push_back(s.name);
+    TuneResult tune = autotune("solo_miner", kernelNames, fixedThreads ? vector<int>{numThreads} : tuneThreadCounts(numThreads),
+                               MINER_TUNE_CHUNKS, cpus,
+                               [&](size_t k, uint64_t first, uint64_t last) {
+        for (uint64_t nonce = first; nonce < last; nonce += scanners[k].lanes) {
+            scanners[k].scan(benchJob, static_cast<uint32_t>(nonce));
+        }
+    });
+    for (const auto& s : scanners) {
+        if (tune.kernel == s.name) scanner = s;
+    }
+    uint64_t minChunk = tune.batch;
+    // Fewer threads than usable only if they measured faster; otherwise the
+    // count keeps following the quota up to every placement CPU
+    size_t maxThreads = tune.threads < numThreads ? tune.threads : cpus.size();
+    if (!fixedThreads) numThreads = usableCpus(maxThreads, cpuLimit);
+    cout << CYAN << ">>> Auto-tune: " << tuneString(tune) << RESET << "\n";
+    cout << CYAN << ">>> SHA256d header kernel: " << scanner.name << " (" << scanner.lanes << " lanes)" << RESET << "\n";
+    cout << CYAN << ">>> Miner threads: " << numThreads << RESET << "\n";
+    merkleEngine.hasher = selectPairHasher();
+    merkleEngine.threads = max(numThreads, 1);
+    cout << CYAN << ">>> Merkle kernel: " << merkleEngine.hasher.name << " (" << merkleEngine.hasher.lanes << " pairs per call)" << RESET << "\n";
+    const char* verifyEnv = getenv("MINER_VERIFY_TXIDS");
+    bool verifyTxids = verifyEnv && *verifyEnv && *verifyEnv != '0';
+    if (verifyTxids) cout << CYAN << ">>> Verifying template txids in the background" << RESET << "\n";
+
+    // Get initial BTC Price
+    string btcPrice = getBTCPrice();
+    cout << GREEN << BOLD << ">>> BTC/USDT Price: $" << btcPrice << RESET << "\n\n";
+
+    // Get legacy address (from loaded wallet)
+    string addrResp = bitcoinRPC("getnewaddress", json::array({"", "legacy"}));
+    string myAddr;
+    if (!addrResp.empty()) {
+        try {
+            json addrJ = json::parse(addrResp);
+            if (addrJ.contains("result") && addrJ["result"].is_string()) {
+                myAddr = addrJ["result"].get<string>();
+                cout << GREEN << ">>> Legacy Address: " << myAddr << RESET << "\n";
             }
+        } catch (...) {}
+    }
+    if (myAddr.empty()) {
+        cerr << RED << ">>> Failed to get legacy address. Run: bitcoin-cli getnewaddress '' 'legacy'" << RESET << "\n";
+        return 1;
+    }
+
+    const uint64_t search_start = 0;
+    const uint64_t search_end = 0xFFFFFFFFULL;
+    int animation_frame = 0;
+    string spinner = "⠋⠙⠹⠸⠼⠴⠦⠧⠇⠏";
+
+    cout << MAGENTA << BOLD << ">>> BitcoinMiner initiated. Entering the matrix..." << RESET << "\n";
+
+    // Long-lived hashing threads fed by the producer; parked ones wait for
+    // the quota to grow
+    MinerPipeline pipe(WORK_QUEUE_UNITS);
+    pipe.active = numThreads;
+    int poolThreads = fixedThreads ? numThreads : static_cast<int>(maxThreads);
+    vector<thread> threads;
+    for (int i = 0; i < poolThreads; ++i) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        threads.emplace_back(minerThread, i, cpu, scanner, ref(pipe));
+    }
+    threads.emplace_back(producerThread, ref(pipe), myAddr, midstates, minChunk, maxThreads, fixedThreads, verifyTxids);
+    cout << BLUE << ">>> Searching for nonce in range [0x" << hex << setfill('0') << setw(8) << search_start << " - 0x" << setw(8) << search_end << "]" << dec << RESET << "\n\n";
+
+    // Stats and tip polling on this thread; templates come from the producer
+    // and hashing stays on the miners. Runs until a block is found.
+    auto last_time = chrono::steady_clock::now();
+    uint64_t last_tried = 0;
+    for (int tick = 1; !pipe.found && !pipe.failed; ++tick) {
+        this_thread::sleep_for(chrono::seconds(1));
+        shared_ptr<const MiningJob> job = pipe.current();
+        if (!job) continue;
+
+        auto now = chrono::steady_clock::now();
+        uint64_t tried = pipe.tried;
+        double seconds = chrono::duration<double>(now - last_time).count();
+        double hashrate = seconds > 0 ? (tried - last_tried) / seconds : 0.0;
+        uint32_t nonce = pipe.lastNonce;
+        last_tried = tried;
+        last_time = now;
+        animation_frame++;
+
+        // Live spinner every second
+        {
+            std::lock_guard<std::mutex> lock(cout_mutex);
+            cout << "\r" << CYAN << "🔥 Mining " << spinner[animation_frame % spinner.length()] << " | Hashes: " << tried << " | Rate: " << fixed << setprecision(2) << hashrate << " H/s" << RESET << flush;
+        }
+
+        // Progress bar over the current header's nonce space
+        if (tick % PROGRESS_BAR_SECONDS == 0) {
+            std::lock_guard<std::mutex> lock(cout_mutex);
+            cout << "\n" << BOLD << ">>> " << RESET;
+            printProgressBar((tried - pipe.templateTried) & 0xFFFFFFFFULL, 0xFFFFFFFFULL, hashrate, animation_frame);
+            cout << " | Current nonce: 0x" << hex << setw(8) << setfill('0') << nonce << dec << " | Extranonce: " << pipe.extranonce << RESET << "\n";
+        }
 
-            // Build full block hex
-            string blockHex = bytesToHex(header);
-            blockHex += encodeVarInt(txHexes.size());
-            for (const auto& txh : txHexes) {
-                blockHex += txh;
+        // Send to Flask
+        if (tick % FLASK_SEND_SECONDS == 0) {
+            string current_price = getBTCPrice();  // Refresh price occasionally
+            sendStatsToFlask(tried, hashrate, nonce, current_price, job->height, search_start, search_end);
+        }
+
+        // New block on the network -> everything queued or in flight is stale
+        if (tick % TEMPLATE_POLL_SECONDS == 0) {
+            string tip = getBestBlockHash();
+            if (!tip.empty() && tip != job->prevHash) {
+                {
+                    std::lock_guard<std::mutex> lock(cout_mutex);
+                    cout << "\n" << YELLOW << ">>> New tip " << tip << ", refreshing template" << RESET << "\n";
+                }
+                pipe.invalidate();
+                pipe.refresh = true;
             }
+        }
+        if (tick % TEMPLATE_REFRESH_SECONDS == 0) pipe.refresh = true;
+    }
+    pipe.shutdown = true;
+    for (auto& t : threads) t.join();
+    if (pipe.failed) return 1;
+
+    // Clear line and celebrate
+    {
+        std::lock_guard<std::mutex> lock(cout_mutex);
+        cout << "\n" << GREEN << BOLD;
+        celebrateBlock();
+        string hashStr = bytesToHex(pipe.foundHash.data(), 32);
+        cout << ">>> BLOCK FOUND! Nonce: 0x" << hex << setw(8) << setfill('0') << pipe.foundNonce << dec << " | Hash: " << hashStr << RESET << "\n";
+    }
 
-            // Submit
-            string submitResp = bitcoinRPC("submitblock", json::array({blockHex}));
-            {
-                std::lock_guard<std::mutex> lock(cout_mutex);
-                if (!submitResp.empty()) {
-                    try {
-                        json submitJ = json::parse(submitResp);
-                        if (submitJ.contains("result") && submitJ["result"].is_null()) {
-                            flashText(">>> BLOCK ACCEPTED! You've hacked the chain! 🚀", 5, 200);
-                        } else {
-                            cout << RED << ">>> Submit response: " << submitResp << RESET << "\n";
-                        }
-                    } catch (...) {
-                        cout << RED << ">>> Submit response: " << submitResp << RESET << "\n";
-                    }
+    // Build full block hex from the template and extranonce it was found on
+    shared_ptr<const MiningJob> job = pipe.lookup(pipe.foundTemplate);
+    if (!job) {
+        cerr << RED << ">>> Template of the found block went stale before submit" << RESET << "\n";
+        return 1;
+    }
+    BlockHeader header = job->headerFor(pipe.foundExtranonce);
+    header.setVersion(pipe.foundVersion);
+    header.setTime(pipe.foundTime);
+    header.setNonce(pipe.foundNonce);
+    string blockHex = bytesToHex(header.data(), header.size());
+    blockHex += encodeVarInt(job->txHexes.size() + 1);
+    blockHex += bytesToHex(job->coinbase.blockBytes(pipe.foundExtranonce));
+    for (const auto& txh : job->txHexes) {
+        blockHex += txh;
+    }
+
+    // Submit
+    string submitResp = bitcoinRPC("submitblock", json::array({blockHex}));
+    {
+        std::lock_guard<std::mutex> lock(cout_mutex);
+        if (!submitResp.empty()) {
+            try {
+                json submitJ = json::parse(submitResp);
+                if (submitJ.contains("result") && submitJ["result"].is_null()) {
+                    flashText(">>> BLOCK ACCEPTED! You've hacked the chain! 🚀", 5, 200);
+                } else {
+                    cout << RED << ">>> Submit response: " << submitResp << RESET << "\n";
                 }
+            } catch (...) {
+                cout << RED << ">>> Submit response: " << submitResp << RESET << "\n";
             }
-            return 0;
         }
     }
-    return 1;
-}
\ No newline at end of file
+    return 0;
+}
@@ -0,0 +1,83 @@
+// work_queue.hpp
+// Bounded lock-free multi-producer/multi-consumer queue (the array queue
+// with per-cell sequence numbers). solo_miner's producer stage pushes
+// prepared work units through it to the hashing threads, so neither side
+// takes a lock or allocates once the queue is built. Both ends are
+// non-blocking: callers decide how to back off when it is full or empty.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+template <class T>
+struct BoundedQueue {
+    // `capacity` is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        cells.reset(new Cell[n]);
+        mask = n - 1;
+        for (size_t i = 0; i < n; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool tryPush(const T& value) {
+        uint64_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& c = cells[pos & mask];
+            uint64_t seq = c.seq.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq - pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.value = value;
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool tryPop(T& out) {
+        uint64_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& c = cells[pos & mask];
+            uint64_t seq = c.seq.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = c.value;
+                    c.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    // A cell is free for the push at position p when seq == p, and holds
+    // that push's value for the pop at p when seq == p + 1.
+    struct Cell {
+        std::atomic<uint64_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    // Producers and consumers each hammer one counter: keep them apart
+    char pad0[64];
+    std::atomic<uint64_t> head{0};
+    char pad1[64];
+    std::atomic<uint64_t> tail{0};
+    char pad2[64];
+};